@@ -0,0 +1,125 @@
+// Copyright (c) 2014 Vittorio Romeo
+// License: MIT License | http://opensource.org/licenses/MIT
+// http://vittorioromeo.info | vittorio.romeo@outlook.com
+
+// Tiny headless benchmarking utilities shared by the `bench_*.cpp`
+// programs. Every result is printed as a JSON object, so that the
+// output of a run can be stored and diffed for regression tracking.
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace bench
+{
+    using Clock = std::chrono::steady_clock;
+
+    // Prevents the compiler from optimizing away a computed value.
+    template <typename T>
+    void doNotOptimize(T&& mValue)
+    {
+        asm volatile("" : : "g"(&mValue) : "memory");
+    }
+
+    struct Sample
+    {
+        double minNs{0}, medianNs{0};
+    };
+
+    // Runs `mSetup` followed by the timed `mRun` `mReps` times, and
+    // returns the minimum and median duration of `mRun`.
+    template <typename TSetup, typename TRun>
+    Sample measure(int mReps, TSetup&& mSetup, TRun&& mRun)
+    {
+        std::vector<double> durations;
+        durations.reserve(mReps);
+
+        for(int i{0}; i < mReps; ++i)
+        {
+            mSetup();
+            auto start(Clock::now());
+            mRun();
+            auto end(Clock::now());
+
+            durations.emplace_back(
+                std::chrono::duration<double, std::nano>(end - start)
+                    .count());
+        }
+
+        std::sort(std::begin(durations), std::end(durations));
+        return {durations.front(), durations[durations.size() / 2]};
+    }
+
+    // Fewer repetitions for bigger workloads, but always at least 3.
+    inline int repsFor(std::size_t mItems)
+    {
+        return std::max(3, std::min(50, int(1000000 / (mItems + 1))));
+    }
+
+    struct Result
+    {
+        std::vector<std::pair<std::string, std::string>> labels;
+        std::vector<std::pair<std::string, double>> metrics;
+    };
+
+    // Collects results and prints them as a JSON array on destruction.
+    class Reporter
+    {
+    private:
+        std::vector<Result> results;
+
+    public:
+        Reporter() = default;
+        Reporter(const Reporter&) = delete;
+        Reporter& operator=(const Reporter&) = delete;
+
+        // Records a timed sample over `mItems` items: the JSON object
+        // will also contain the median time per item.
+        Result& add(std::vector<std::pair<std::string, std::string>> mLabels,
+            std::size_t mItems, const Sample& mSample)
+        {
+            results.emplace_back();
+            auto& result(results.back());
+
+            result.labels = std::move(mLabels);
+            result.metrics = {{"items", double(mItems)},
+                {"min_ns", mSample.minNs}, {"median_ns", mSample.medianNs},
+                {"ns_per_item", mSample.medianNs / std::max<std::size_t>(
+                                                       mItems, 1)}};
+
+            return result;
+        }
+
+        ~Reporter()
+        {
+            std::printf("[\n");
+            for(std::size_t i{0}; i < results.size(); ++i)
+            {
+                const auto& result(results[i]);
+                std::printf("  {");
+
+                bool first{true};
+                for(const auto& l : result.labels)
+                {
+                    std::printf("%s\"%s\": \"%s\"", first ? "" : ", ",
+                        l.first.c_str(), l.second.c_str());
+                    first = false;
+                }
+                for(const auto& m : result.metrics)
+                {
+                    std::printf("%s\"%s\": %.3f", first ? "" : ", ",
+                        m.first.c_str(), m.second);
+                    first = false;
+                }
+
+                std::printf("}%s\n", i + 1 < results.size() ? "," : "");
+            }
+            std::printf("]\n");
+        }
+    };
+}
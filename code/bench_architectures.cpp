@@ -0,0 +1,549 @@
+// Copyright (c) 2014 Vittorio Romeo
+// License: MIT License | http://opensource.org/licenses/MIT
+// http://vittorioromeo.info | vittorio.romeo@outlook.com
+
+// Headless comparison of the game loop architectures of this
+// repository, running the same scripted session through each of them:
+// * p07: free-function loop over a `std::vector<Brick>` of values
+// * p09: `Game` class with value members
+// * p10: `Manager` of polymorphic `std::unique_ptr<Entity>`
+// * p11: p10's `Manager`, with lives and multi-hit bricks
+// * p12: the current `Manager`, with lightweight entities
+// The p07-p11 designs are reproduced here without their window and
+// keyboard polling. p12 is driven through its manager, collision
+// dispatch and event batch, as `Simulation::update` also times its
+// phases and schedules respawns. Every design plays by the same rules,
+// on a single-window field: bricks take 1 to 3 hits, lives are not
+// limited, and a ball lost at the bottom is respawned on the next
+// tick. Every session reports the cost per tick and the memory
+// footprint (object size plus live heap bytes) of its world.
+//
+// Usage: ./compile.sh bench_architectures.cpp -O3
+
+#define ARKANOID_NO_MAIN
+#define ARKANOID_TRACK_ALLOCATIONS
+#define ARKANOID_WORLD_SCREENS 1
+#include "p12.cpp"
+#include "bench.hpp"
+
+#include <map>
+#include <typeinfo>
+
+namespace arch
+{
+    // p07 and p09 store their entities by value, with no common base.
+    struct ValueBase
+    {
+        bool destroyed{false};
+    };
+
+    // p10 and p11 use a polymorphic hierarchy.
+    struct Entity
+    {
+        bool destroyed{false};
+
+        virtual ~Entity() {}
+        virtual void update() {}
+    };
+
+    // Entities keep the `sf::Shape` members of the original designs.
+    struct Rectangle
+    {
+        sf::RectangleShape shape;
+
+        float x() const noexcept { return shape.getPosition().x; }
+        float y() const noexcept { return shape.getPosition().y; }
+        float width() const noexcept { return shape.getSize().x; }
+        float height() const noexcept { return shape.getSize().y; }
+        float left() const noexcept { return x() - width() / 2.f; }
+        float right() const noexcept { return x() + width() / 2.f; }
+        float top() const noexcept { return y() - height() / 2.f; }
+        float bottom() const noexcept { return y() + height() / 2.f; }
+    };
+
+    struct Circle
+    {
+        sf::CircleShape shape;
+
+        float x() const noexcept { return shape.getPosition().x; }
+        float y() const noexcept { return shape.getPosition().y; }
+        float radius() const noexcept { return shape.getRadius(); }
+        float left() const noexcept { return x() - radius(); }
+        float right() const noexcept { return x() + radius(); }
+        float top() const noexcept { return y() - radius(); }
+        float bottom() const noexcept { return y() + radius(); }
+    };
+
+    template <typename TBase>
+    class Ball : public TBase, public Circle
+    {
+    public:
+        static constexpr float defRadius{10.f}, defVelocity{8.f};
+
+        sf::Vector2f velocity{-defVelocity, -defVelocity};
+
+        Ball(float mX, float mY)
+        {
+            shape.setPosition(mX, mY);
+            shape.setRadius(defRadius);
+            shape.setFillColor(sf::Color::Red);
+            shape.setOrigin(defRadius, defRadius);
+        }
+
+        void update()
+        {
+            shape.move(velocity);
+
+            if(left() < 0)
+                velocity.x = defVelocity;
+            else if(right() > wndWidth)
+                velocity.x = -defVelocity;
+
+            if(top() < 0)
+                velocity.y = defVelocity;
+            else if(bottom() > wndHeight)
+                this->destroyed = true;
+        }
+    };
+
+    template <typename TBase>
+    class Paddle : public TBase, public Rectangle
+    {
+    public:
+        static constexpr float defWidth{60.f}, defHeight{20.f};
+        static constexpr float defVelocity{8.f};
+
+        sf::Vector2f velocity;
+        const InputState* input;
+
+        Paddle(float mX, float mY, const InputState& mInput) : input{&mInput}
+        {
+            shape.setPosition(mX, mY);
+            shape.setSize({defWidth, defHeight});
+            shape.setFillColor(sf::Color::Red);
+            shape.setOrigin(defWidth / 2.f, defHeight / 2.f);
+        }
+
+        void update()
+        {
+            if(input->left && left() > 0)
+                velocity.x = -defVelocity;
+            else if(input->right && right() < wndWidth)
+                velocity.x = defVelocity;
+            else
+                velocity.x = 0;
+
+            shape.move(velocity);
+        }
+    };
+
+    // Only p11 updates the colour of its bricks every tick.
+    template <typename TBase, bool TColorByHits>
+    class Brick : public TBase, public Rectangle
+    {
+    public:
+        static constexpr float defWidth{60.f}, defHeight{20.f};
+
+        int requiredHits{1};
+
+        Brick(float mX, float mY)
+        {
+            shape.setPosition(mX, mY);
+            shape.setSize({defWidth, defHeight});
+            shape.setFillColor(sf::Color::Yellow);
+            shape.setOrigin(defWidth / 2.f, defHeight / 2.f);
+        }
+
+        void update()
+        {
+            if(!TColorByHits) return;
+
+            sf::Uint8 alpha(
+                requiredHits == 1 ? 80 : requiredHits == 2 ? 170 : 255);
+            shape.setFillColor({255, 255, 0, alpha});
+        }
+    };
+
+    template <typename TPaddle, typename TBall>
+    void solvePaddleBallCollision(const TPaddle& mPaddle, TBall& mBall) noexcept
+    {
+        if(!isIntersecting(mPaddle, mBall)) return;
+
+        mBall.velocity.y = -TBall::defVelocity;
+        mBall.velocity.x =
+            mBall.x() < mPaddle.x() ? -TBall::defVelocity : TBall::defVelocity;
+    }
+
+    template <typename TBrick, typename TBall>
+    void solveBrickBallCollision(TBrick& mBrick, TBall& mBall) noexcept
+    {
+        if(!isIntersecting(mBrick, mBall)) return;
+
+        --mBrick.requiredHits;
+        if(mBrick.requiredHits <= 0) mBrick.destroyed = true;
+
+        float overlapLeft{mBall.right() - mBrick.left()};
+        float overlapRight{mBrick.right() - mBall.left()};
+        float overlapTop{mBall.bottom() - mBrick.top()};
+        float overlapBottom{mBrick.bottom() - mBall.top()};
+
+        bool ballFromLeft(std::abs(overlapLeft) < std::abs(overlapRight));
+        bool ballFromTop(std::abs(overlapTop) < std::abs(overlapBottom));
+
+        float minOverlapX{ballFromLeft ? overlapLeft : overlapRight};
+        float minOverlapY{ballFromTop ? overlapTop : overlapBottom};
+
+        if(std::abs(minOverlapX) < std::abs(minOverlapY))
+            mBall.velocity.x =
+                ballFromLeft ? -TBall::defVelocity : TBall::defVelocity;
+        else
+            mBall.velocity.y =
+                ballFromTop ? -TBall::defVelocity : TBall::defVelocity;
+    }
+
+    // Calls `mFunc(x, y, requiredHits)` for every brick of the field.
+    template <typename TFunc>
+    void forEachBrickOf(std::size_t mBricks, const TFunc& mFunc)
+    {
+        auto columns(BrickLattice::getColumnsFor(mBricks));
+        for(std::size_t i{0}; i < mBricks; ++i)
+        {
+            int iX(i % columns), iY(i / columns);
+            auto position(BrickLattice::getPosition(iX, iY));
+            mFunc(position.x, position.y, 1 + ((iX * iY) % 3));
+        }
+    }
+
+    // p07: the whole game lives in `main`, as local values.
+    struct P07
+    {
+        using Ball = arch::Ball<ValueBase>;
+        using Paddle = arch::Paddle<ValueBase>;
+        using Brick = arch::Brick<ValueBase, false>;
+
+        Ball ball{wndWidth / 2.f, wndHeight / 2.f};
+        Paddle paddle;
+        std::vector<Brick> bricks;
+
+        P07(std::size_t mBricks, const InputState& mInput)
+            : paddle{wndWidth / 2, wndHeight - 50, mInput}
+        {
+            forEachBrickOf(mBricks, [this](float mX, float mY, int mHits)
+                {
+                    bricks.emplace_back(mX, mY);
+                    bricks.back().requiredHits = mHits;
+                });
+        }
+
+        void tick()
+        {
+            if(ball.destroyed) ball = Ball{wndWidth / 2.f, wndHeight / 2.f};
+
+            ball.update();
+            paddle.update();
+            for(auto& brick : bricks)
+            {
+                brick.update();
+                solveBrickBallCollision(brick, ball);
+            }
+
+            bricks.erase(std::remove_if(std::begin(bricks), std::end(bricks),
+                             [](const auto& mBrick)
+                             {
+                                 return mBrick.destroyed;
+                             }),
+                std::end(bricks));
+
+            solvePaddleBallCollision(paddle, ball);
+        }
+    };
+
+    // p09: the same values, encapsulated in a `Game` class with a
+    // pausable state.
+    class P09
+    {
+    private:
+        using Ball = arch::Ball<ValueBase>;
+        using Paddle = arch::Paddle<ValueBase>;
+        using Brick = arch::Brick<ValueBase, false>;
+
+        enum class State
+        {
+            Paused,
+            InProgress
+        };
+
+        Ball ball{wndWidth / 2.f, wndHeight / 2.f};
+        Paddle paddle;
+        std::vector<Brick> bricks;
+        State state{State::InProgress};
+
+    public:
+        P09(std::size_t mBricks, const InputState& mInput)
+            : paddle{wndWidth / 2, wndHeight - 50, mInput}
+        {
+            forEachBrickOf(mBricks, [this](float mX, float mY, int mHits)
+                {
+                    bricks.emplace_back(mX, mY);
+                    bricks.back().requiredHits = mHits;
+                });
+        }
+
+        void tick()
+        {
+            if(state == State::Paused) return;
+            if(ball.destroyed) ball = Ball{wndWidth / 2.f, wndHeight / 2.f};
+
+            ball.update();
+            paddle.update();
+            for(auto& brick : bricks)
+            {
+                brick.update();
+                solveBrickBallCollision(brick, ball);
+            }
+
+            bricks.erase(std::remove_if(std::begin(bricks), std::end(bricks),
+                             [](const auto& mBrick)
+                             {
+                                 return mBrick.destroyed;
+                             }),
+                std::end(bricks));
+
+            solvePaddleBallCollision(paddle, ball);
+        }
+    };
+
+    // The `Manager` of p10 and p11.
+    class Manager
+    {
+    private:
+        std::vector<std::unique_ptr<Entity>> entities;
+        std::map<std::size_t, std::vector<Entity*>> groupedEntities;
+
+    public:
+        template <typename T, typename... TArgs>
+        T& create(TArgs&&... mArgs)
+        {
+            auto uPtr(std::make_unique<T>(std::forward<TArgs>(mArgs)...));
+            auto ptr(uPtr.get());
+            groupedEntities[typeid(T).hash_code()].emplace_back(ptr);
+            entities.emplace_back(std::move(uPtr));
+
+            return *ptr;
+        }
+
+        void refresh()
+        {
+            for(auto& pair : groupedEntities)
+            {
+                auto& vector(pair.second);
+
+                vector.erase(
+                    std::remove_if(std::begin(vector), std::end(vector),
+                        [](auto mPtr)
+                        {
+                            return mPtr->destroyed;
+                        }),
+                    std::end(vector));
+            }
+
+            entities.erase(
+                std::remove_if(std::begin(entities), std::end(entities),
+                    [](const auto& mUPtr)
+                    {
+                        return mUPtr->destroyed;
+                    }),
+                std::end(entities));
+        }
+
+        template <typename T>
+        auto& getAll()
+        {
+            return groupedEntities[typeid(T).hash_code()];
+        }
+
+        template <typename T, typename TFunc>
+        void forEach(const TFunc& mFunc)
+        {
+            for(auto ptr : getAll<T>()) mFunc(*static_cast<T*>(ptr));
+        }
+
+        void update()
+        {
+            for(auto& e : entities) e->update();
+        }
+    };
+
+    // p10 and p11 share their `Manager`-driven loop.
+    template <bool TColorByHits>
+    class ManagerDesign
+    {
+    private:
+        using Ball = arch::Ball<Entity>;
+        using Paddle = arch::Paddle<Entity>;
+        using Brick = arch::Brick<Entity, TColorByHits>;
+
+        Manager manager;
+
+    public:
+        ManagerDesign(std::size_t mBricks, const InputState& mInput)
+        {
+            forEachBrickOf(mBricks, [this](float mX, float mY, int mHits)
+                {
+                    manager.create<Brick>(mX, mY).requiredHits = mHits;
+                });
+
+            manager.create<Ball>(wndWidth / 2.f, wndHeight / 2.f);
+            manager.create<Paddle>(wndWidth / 2, wndHeight - 50, mInput);
+        }
+
+        void tick()
+        {
+            if(manager.getAll<Ball>().empty())
+                manager.create<Ball>(wndWidth / 2.f, wndHeight / 2.f);
+
+            manager.update();
+
+            manager.forEach<Ball>([this](auto& mBall)
+                {
+                    manager.forEach<Brick>([&mBall](auto& mBrick)
+                        {
+                            solveBrickBallCollision(mBrick, mBall);
+                        });
+                    manager.forEach<Paddle>([&mBall](auto& mPaddle)
+                        {
+                            solvePaddleBallCollision(mPaddle, mBall);
+                        });
+                });
+
+            manager.refresh();
+        }
+    };
+
+    using P10 = ManagerDesign<false>;
+    using P11 = ManagerDesign<true>;
+
+    // p12: the game's own manager, with its compile-time collision
+    // dispatch and batched collision events.
+    class P12
+    {
+    private:
+        ::Manager manager;
+        std::vector<CollisionEvent> collisionEvents;
+
+    public:
+        P12(std::size_t mBricks, const InputState& mInput)
+        {
+            manager.reserve<::Brick>(mBricks);
+            forEachBrickOf(mBricks, [this](float mX, float mY, int mHits)
+                {
+                    manager.create<::Brick>(mX, mY).requiredHits = mHits;
+                });
+
+            manager.create<::Ball>(wndWidth / 2.f, wndHeight / 2.f);
+            manager.create<::Paddle>(wndWidth / 2, wndHeight - 50, mInput);
+
+            collisionEvents.reserve(64);
+        }
+
+        // Called by the collision handlers.
+        void emit(const CollisionEvent& mEvent)
+        {
+            collisionEvents.emplace_back(mEvent);
+        }
+
+        void tick()
+        {
+            if(manager.empty<::Ball>())
+                manager.create<::Ball>(wndWidth / 2.f, wndHeight / 2.f);
+
+            manager.update(StaticEntities{});
+
+            collisionEvents.clear();
+            solveCollisions(manager, *this, Collidables{});
+
+            for(const auto& event : collisionEvents)
+            {
+                if(event.type != CollisionEvent::Type::BallBrick) continue;
+
+                auto& brick(static_cast<::Brick&>(*event.second));
+                if(!brick.destroyed && --brick.requiredHits <= 0)
+                    brick.destroyed = true;
+            }
+
+            manager.refresh();
+        }
+    };
+}
+
+namespace
+{
+    constexpr int sessionTicks{3600};
+
+    // The scripted input: the paddle sweeps left and right.
+    void applyScript(InputState& mInput, int mTick) noexcept
+    {
+        auto phase(mTick % 120);
+        mInput.left = phase < 50;
+        mInput.right = phase >= 60 && phase < 110;
+    }
+
+    template <typename TDesign>
+    void runSession(bench::Reporter& mReporter, const char* mName,
+        std::size_t mBricks)
+    {
+        InputState input;
+        std::unique_ptr<TDesign> design;
+
+        // Footprints are measured at the end of the session, once the
+        // structures built on demand (such as p12's brick grid) exist.
+        std::size_t heapBefore{0}, footprint{0};
+        auto setup([&]
+            {
+                design.reset();
+
+                heapBefore = allocationCounters.liveBytes;
+                design = std::make_unique<TDesign>(mBricks, input);
+            });
+
+        auto session([&]
+            {
+                for(int i{0}; i < sessionTicks; ++i)
+                {
+                    applyScript(input, i);
+                    design->tick();
+                }
+
+                footprint = allocationCounters.liveBytes - heapBefore;
+            });
+
+        auto sample(bench::measure(bench::repsFor(mBricks * 100), setup, session));
+
+        auto& result(mReporter.add({{"suite", "architectures"},
+                                       {"design", mName},
+                                       {"bricks", std::to_string(mBricks)}},
+            sessionTicks, sample));
+
+        result.metrics.emplace_back("footprint_bytes", footprint);
+        result.metrics.emplace_back(
+            "footprint_bytes_per_brick", double(footprint) / mBricks);
+    }
+}
+
+int main()
+{
+    const std::size_t brickCounts[]{44, 1000, 10000};
+
+    bench::Reporter reporter;
+
+    for(auto bricks : brickCounts)
+    {
+        runSession<arch::P07>(reporter, "p07", bricks);
+        runSession<arch::P09>(reporter, "p09", bricks);
+        runSession<arch::P10>(reporter, "p10", bricks);
+        runSession<arch::P11>(reporter, "p11", bricks);
+        runSession<arch::P12>(reporter, "p12", bricks);
+    }
+
+    return 0;
+}
@@ -0,0 +1,207 @@
+// Copyright (c) 2014 Vittorio Romeo
+// License: MIT License | http://opensource.org/licenses/MIT
+// http://vittorioromeo.info | vittorio.romeo@outlook.com
+
+// Headless scaling benchmark for the ball/brick collision pipeline of
+// p12. Brick fields are built from the game's `BrickLattice` (from the
+// original 44 bricks up to 1M bricks) and filled with 1 to 10k balls.
+// Every `Manager::forEachPair` broadphase is measured in nanoseconds per
+// ball-tick, together with cache and branch misses when hardware
+// counters are available.
+//
+// Usage: ./compile.sh bench_collision.cpp -O3
+// The compiled program optionally takes the maximum number of
+// ball/brick checks per measured tick as its first argument:
+// brute force combinations above it are skipped.
+
+#define ARKANOID_NO_MAIN
+#include "p12.cpp"
+#include "bench.hpp"
+
+#include <cstdlib>
+
+namespace
+{
+    // Lays out `mCount` bricks on the game's lattice.
+    template <typename TManager>
+    sf::Vector2f buildBricks(TManager& mManager, std::size_t mCount)
+    {
+        auto columns(BrickLattice::getColumnsFor(mCount));
+        mManager.template reserve<Brick>(mCount);
+
+        sf::Vector2f size;
+        for(std::size_t i{0}; i < mCount; ++i)
+        {
+            auto position(BrickLattice::getPosition(i % columns, i / columns));
+            auto& brick(mManager.template create<Brick>(position.x, position.y));
+
+            size.x = std::max(size.x, brick.right());
+            size.y = std::max(size.y, brick.bottom());
+        }
+
+        return size;
+    }
+
+    // Spreads `mCount` balls over the field with a simple LCG, so that
+    // some of them overlap bricks on every tick.
+    template <typename TManager>
+    void buildBalls(
+        TManager& mManager, const sf::Vector2f& mField, std::size_t mCount)
+    {
+        std::uint32_t seed{12345};
+        auto next([&seed]
+            {
+                seed = seed * 1664525u + 1013904223u;
+                return (seed >> 8) / float(1 << 24);
+            });
+
+        mManager.template reserve<Ball>(mCount);
+        for(std::size_t i{0}; i < mCount; ++i)
+            mManager.template create<Ball>(
+                next() * mField.x, next() * mField.y);
+    }
+
+    // The ball/brick collision pass of the game, with the given
+    // `Manager::forEachPair` broadphase. Solvers don't damage bricks,
+    // so that every tick works on the same field. `prepare` runs
+    // before every tick, untimed.
+    template <typename TBroadphase, bool TQuadratic = false>
+    struct Pairwise
+    {
+        static constexpr bool quadratic{TQuadratic};
+
+        template <typename TManager>
+        static void prepare(TManager&)
+        {
+        }
+
+        template <typename TManager>
+        static void tick(TManager& mManager)
+        {
+            mManager.template forEachPair<Ball, Brick, TBroadphase>(
+                [](auto& mBall, auto& mBrick)
+                {
+                    solveBrickBallCollision(mBrick, mBall);
+                });
+        }
+    };
+
+    struct BruteForce : Pairwise<broadphase::BruteForce, true>
+    {
+        static constexpr const char* name{"brute_force"};
+    };
+
+    struct Grid : Pairwise<broadphase::Grid>
+    {
+        static constexpr const char* name{"grid"};
+    };
+
+    struct SweepAndPrune : Pairwise<broadphase::SweepAndPrune>
+    {
+        static constexpr const char* name{"sweep_and_prune"};
+    };
+
+    // The game's choice: the grid is built once, as bricks never move.
+    struct Indexed : Pairwise<broadphase::Indexed>
+    {
+        static constexpr const char* name{"indexed"};
+    };
+
+    // The same, on the tick after a brick was destroyed and removed
+    // by `refresh`: the pass that would hitch if the grid had to be
+    // rebuilt.
+    struct IndexedAfterHit : Indexed
+    {
+        static constexpr const char* name{"indexed_after_hit"};
+
+        template <typename TManager>
+        static void prepare(TManager& mManager)
+        {
+            const auto& bricks(mManager.template getAll<Brick>());
+            if(bricks.size() > 1) bricks.back()->destroyed = true;
+            mManager.refresh();
+        }
+    };
+
+    constexpr const char* BruteForce::name;
+    constexpr const char* Grid::name;
+    constexpr const char* SweepAndPrune::name;
+    constexpr const char* Indexed::name;
+    constexpr const char* IndexedAfterHit::name;
+
+    template <typename TStrategy>
+    void runStrategy(bench::Reporter& mReporter, std::size_t mBricks,
+        std::size_t mBalls, double mMaxChecks)
+    {
+        if(TStrategy::quadratic && double(mBricks) * mBalls > mMaxChecks)
+        {
+            std::fprintf(stderr, "skipping %s: %zu bricks x %zu balls\n",
+                TStrategy::name, mBricks, mBalls);
+            return;
+        }
+
+        Manager manager;
+        auto field(buildBricks(manager, mBricks));
+        buildBalls(manager, field, mBalls);
+
+        auto prepare([&manager]
+            {
+                TStrategy::prepare(manager);
+            });
+        auto tick([&manager]
+            {
+                TStrategy::tick(manager);
+            });
+
+        // Warm up once, so that the first measured tick doesn't pay
+        // for cold caches only.
+        tick();
+
+        auto reps(bench::repsFor(TStrategy::quadratic
+                ? mBricks * mBalls / 100
+                : mBricks + mBalls));
+
+        PerfCounters counters{
+            perfEvents::cacheMisses, perfEvents::branchMisses};
+
+        counters.start();
+        auto sample(bench::measure(reps, prepare, tick));
+        counters.stop();
+
+        auto& result(mReporter.add(
+            {{"suite", "collision"}, {"strategy", TStrategy::name},
+                {"bricks", std::to_string(mBricks)},
+                {"balls", std::to_string(mBalls)}},
+            mBalls, sample));
+
+        auto ballTicks(double(mBalls) * reps);
+        auto values(counters.read());
+        for(std::size_t i{0}; i < counters.getCount(); ++i)
+            result.metrics.emplace_back(
+                std::string{counters.getName(i)} + "_per_item",
+                values[i] / ballTicks);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    double maxChecks{1e9};
+    if(argc > 1) maxChecks = std::strtod(argv[1], nullptr);
+
+    const std::size_t brickCounts[]{44, 1000, 10000, 100000, 1000000};
+    const std::size_t ballCounts[]{1, 10, 100, 1000, 10000};
+
+    bench::Reporter reporter;
+
+    for(auto bricks : brickCounts)
+        for(auto balls : ballCounts)
+        {
+            runStrategy<BruteForce>(reporter, bricks, balls, maxChecks);
+            runStrategy<Grid>(reporter, bricks, balls, maxChecks);
+            runStrategy<SweepAndPrune>(reporter, bricks, balls, maxChecks);
+            runStrategy<Indexed>(reporter, bricks, balls, maxChecks);
+            runStrategy<IndexedAfterHit>(reporter, bricks, balls, maxChecks);
+        }
+
+    return 0;
+}
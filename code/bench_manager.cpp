@@ -0,0 +1,335 @@
+// Copyright (c) 2014 Vittorio Romeo
+// License: MIT License | http://opensource.org/licenses/MIT
+// http://vittorioromeo.info | vittorio.romeo@outlook.com
+
+// Headless microbenchmarks for the `Manager` operations of p12.
+// Every operation is measured on a mix of balls, bricks and paddles,
+// from 100 to 1M entities, and the results are printed as JSON.
+//
+// Usage: ./compile.sh bench_manager.cpp -O3
+// The compiled program optionally takes the maximum entity count as
+// its first argument. Every storage backend is run through the same
+// suite, so that alternative `Manager` implementations can be
+// compared side by side. The suite also checks that staggered updates
+// keep their rate while entities churn: the program fails otherwise.
+
+#define ARKANOID_NO_MAIN
+#include "p12.cpp"
+#include "bench.hpp"
+
+#include <cstdlib>
+#include <tuple>
+
+namespace
+{
+    // A cosmetic entity type, updated once every 4 ticks. It records
+    // the longest wait of any of its entities between two updates, in
+    // ticks counted by the benchmark.
+    struct Decoration : EntityBase<Decoration>
+    {
+        static std::size_t tick, maxGap;
+
+        std::size_t lastUpdate{tick};
+
+        void onUpdate()
+        {
+            maxGap = std::max(maxGap, tick - lastUpdate);
+            lastUpdate = tick;
+        }
+    };
+
+    std::size_t Decoration::tick{0}, Decoration::maxGap{0};
+}
+
+template <>
+struct UpdateRateFor<Decoration>
+{
+    static constexpr std::size_t value{4};
+};
+
+namespace
+{
+    const InputState benchInput;
+
+    // Storage backends: every type uses the same policy. The game's own
+    // choice can't be measured here, as its paddle is a singleton.
+    template <typename T>
+    struct AllHeap
+    {
+        using Type = storage::Heap<T>;
+    };
+
+    template <typename T>
+    struct AllPools
+    {
+        using Type = storage::Pool<T>;
+    };
+
+    enum class Kind
+    {
+        Brick,
+        Ball,
+        Paddle
+    };
+
+    // 70% bricks, 25% balls and 5% paddles, spread over the window:
+    // calls `mFunc(kind, x, y)` for each of them.
+    template <typename TFunc>
+    void forEachSpawn(std::size_t mCount, const TFunc& mFunc)
+    {
+        for(std::size_t i{0}; i < mCount; ++i)
+        {
+            float x(10.f + (i * 37) % (wndWidth - 20));
+            float y(10.f + (i * 53) % (wndHeight - 20));
+
+            auto kind(i % 20);
+            mFunc(kind < 14 ? Kind::Brick
+                            : kind < 19 ? Kind::Ball : Kind::Paddle,
+                x, y);
+        }
+    }
+
+    template <typename TManager>
+    void populate(TManager& mManager, std::size_t mCount)
+    {
+        forEachSpawn(mCount, [&mManager](Kind mKind, float mX, float mY)
+            {
+                if(mKind == Kind::Brick)
+                    mManager.template create<Brick>(mX, mY);
+                else if(mKind == Kind::Ball)
+                    mManager.template create<Ball>(mX, mY);
+                else
+                    mManager.template create<Paddle>(mX, mY, benchInput);
+            });
+    }
+
+    // Marks one entity every `mStride` as destroyed (none if zero).
+    template <typename TManager>
+    void destroyEvery(TManager& mManager, std::size_t mStride)
+    {
+        if(mStride == 0) return;
+
+        std::size_t i{0};
+        auto mark([&i, mStride](auto& mEntity)
+            {
+                if(i++ % mStride == 0) mEntity.destroyed = true;
+            });
+
+        mManager.template forEach<Brick>(mark);
+        mManager.template forEach<Ball>(mark);
+        mManager.template forEach<Paddle>(mark);
+    }
+
+    // Returns `false` if a check failed.
+    template <typename TManager>
+    bool runSuite(bench::Reporter& mReporter, const std::string& mBackend,
+        std::size_t mMax)
+    {
+        bool passed{true};
+
+        for(std::size_t n{100}; n <= mMax; n *= 10)
+        {
+            auto reps(bench::repsFor(n));
+            auto manager(std::make_unique<TManager>());
+
+            auto report([&](const std::string& mOperation, std::size_t mItems,
+                const bench::Sample& mSample)
+                {
+                    mReporter.add({{"suite", "manager"}, {"backend", mBackend},
+                                      {"operation", mOperation},
+                                      {"entities", std::to_string(n)}},
+                        mItems, mSample);
+                });
+
+            auto fresh([&]
+                {
+                    manager = std::make_unique<TManager>();
+                });
+            auto freshPopulated([&]
+                {
+                    fresh();
+                    populate(*manager, n);
+                });
+
+            auto populated([&]
+                {
+                    populate(*manager, n);
+                });
+            report("create", n, bench::measure(reps, fresh, populated));
+
+            // The same mix, created type by type with `createBulk`.
+            std::vector<std::tuple<float, float>> brickArgs, ballArgs;
+            std::vector<std::tuple<float, float, const InputState&>>
+                paddleArgs;
+
+            forEachSpawn(n, [&](Kind mKind, float mX, float mY)
+                {
+                    if(mKind == Kind::Brick)
+                        brickArgs.emplace_back(mX, mY);
+                    else if(mKind == Kind::Ball)
+                        ballArgs.emplace_back(mX, mY);
+                    else
+                        paddleArgs.emplace_back(mX, mY, benchInput);
+                });
+
+            auto populatedBulk([&]
+                {
+                    manager->template createBulk<Brick>(brickArgs);
+                    manager->template createBulk<Ball>(ballArgs);
+                    manager->template createBulk<Paddle>(paddleArgs);
+                });
+            report(
+                "create_bulk", n, bench::measure(reps, fresh, populatedBulk));
+
+            const std::pair<const char*, std::size_t> refreshCases[]{
+                {"refresh_0pct", 0}, {"refresh_1pct", 100},
+                {"refresh_50pct", 2}};
+
+            for(const auto& c : refreshCases)
+            {
+                auto setup([&]
+                    {
+                        freshPopulated();
+                        destroyEvery(*manager, c.second);
+                    });
+                auto refresh([&]
+                    {
+                        manager->refresh();
+                    });
+                report(c.first, n, bench::measure(reps, setup, refresh));
+            }
+
+            freshPopulated();
+            auto none([]
+                {
+                });
+
+            constexpr std::size_t queries{1000};
+            auto getAll([&]
+                {
+                    std::size_t total{0};
+                    for(std::size_t i{0}; i < queries; ++i)
+                        total += manager->template getAll<Brick>().size();
+                    bench::doNotOptimize(total);
+                });
+            report("getAll", queries, bench::measure(reps, none, getAll));
+
+            auto count([&]
+                {
+                    std::size_t total{0};
+                    for(std::size_t i{0}; i < queries; ++i)
+                        total += manager->template count<Brick>();
+                    bench::doNotOptimize(total);
+                });
+            report("count", queries, bench::measure(reps, none, count));
+
+            auto forEach([&]
+                {
+                    int total{0};
+                    manager->template forEach<Brick>([&total](auto& mBrick)
+                        {
+                            total += mBrick.requiredHits;
+                        });
+                    bench::doNotOptimize(total);
+                });
+            report("forEach", n, bench::measure(reps, none, forEach));
+
+            // Bricks start asleep, and are never updated: results are
+            // per awake entity.
+            auto awake(n - manager->template count<Brick>());
+
+            auto update([&]
+                {
+                    manager->update();
+                });
+            report("update", awake, bench::measure(reps, none, update));
+
+            // The same update, without virtual calls.
+            auto updateStatic([&]
+                {
+                    manager->update(StaticEntities{});
+                });
+            report("update_static", awake,
+                bench::measure(reps, none, updateStatic));
+
+            auto clear([&]
+                {
+                    manager->clear();
+                });
+            report("clear", n, bench::measure(reps, freshPopulated, clear));
+
+            auto reset([&]
+                {
+                    manager->reset();
+                });
+            report("reset", n, bench::measure(reps, freshPopulated, reset));
+
+            // Creation into the memory kept by `reset`.
+            auto populatedReset([&]
+                {
+                    freshPopulated();
+                    manager->reset();
+                });
+            report("create_after_reset", n,
+                bench::measure(reps, populatedReset, populated));
+
+            // Decorations, with the oldest one replaced before every
+            // tick: however the churn moves them around, every
+            // decoration must be updated once every 4 ticks. Only the
+            // update is measured, per updated entity.
+            constexpr int churnTicks{64};
+            constexpr auto rate(UpdateRateFor<Decoration>::value);
+
+            fresh();
+            for(std::size_t i{0}; i < n; ++i)
+                manager->template create<Decoration>();
+            Decoration::maxGap = 0;
+
+            auto replaceOldest([&]
+                {
+                    manager->template getAll<Decoration>().front()->destroyed =
+                        true;
+                    manager->refresh();
+                    manager->template create<Decoration>();
+                });
+            auto updateTick([&]
+                {
+                    manager->update();
+                    ++Decoration::tick;
+                });
+            report("update_quarter_rate_churn", n / rate,
+                bench::measure(churnTicks, replaceOldest, updateTick));
+
+            // Entities that were never updated again count too.
+            manager->template forEach<Decoration>([](auto& mDecoration)
+                {
+                    Decoration::maxGap = std::max(Decoration::maxGap,
+                        Decoration::tick - mDecoration.lastUpdate);
+                });
+
+            if(Decoration::maxGap > rate)
+            {
+                std::fprintf(stderr,
+                    "%s, %zu entities: a decoration waited %zu ticks "
+                    "between updates (rate %zu)\n",
+                    mBackend.c_str(), n, Decoration::maxGap, rate);
+                passed = false;
+            }
+        }
+
+        return passed;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    std::size_t maxEntities{1000000};
+    if(argc > 1) maxEntities = std::strtoull(argv[1], nullptr, 10);
+
+    bench::Reporter reporter;
+    bool passed{true};
+    passed &= runSuite<BasicManager<AllHeap>>(reporter, "heap", maxEntities);
+    passed &= runSuite<BasicManager<AllPools>>(reporter, "pool", maxEntities);
+
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,3295 @@
+// Copyright (c) 2014 Vittorio Romeo
+// License: MIT License | http://opensource.org/licenses/MIT
+// http://vittorioromeo.info | vittorio.romeo@outlook.com
+
+// Our game is finished, but it does not scale well to levels with
+// thousands of bricks and balls. In this code segment, we'll start
+// optimizing it:
+// * Lightweight entities that share prototype shapes
+// * Input sampled once per frame, so that benchmarks can run headless
+// * Game rules separated from rendering, to simulate sessions headless
+// * Per-phase allocation tracking, and allocation-free frames
+// * Optional per-phase hardware performance counters
+// * Optional sampling profiler, writing folded stacks per phase
+// * Frame and tick duration histograms, reported as percentiles
+// * Frame budget watchdog, logging hitches that can be replayed headless
+// * Timed sequences (ball respawn, victory text) on a pooled timer wheel
+// * Dense type ids, and non-allocating const queries on the manager
+// * Win/lose transitions driven by the manager's live counts
+// * Pairwise collision queries, with a broadphase chosen per type pair
+// * Collision handlers and layers dispatched at compile time
+// * Storage policies (heap, pool, singleton) chosen per entity type
+// * Statically dispatched updates for known entity types (CRTP)
+// * Capacity reservation and bulk creation on the manager
+// * Memory and occupancy statistics, dumped as JSON with `F10`
+// * Restarts that reuse the manager's memory
+// * Collision effects applied in a batch, from a buffer of events
+// * Sleeping entities, skipped by updates
+// * Update rate tiers per entity type, staggered over ticks
+// * Draws sorted by render key (layer, material, shape, depth)
+// * A world taller than the window, with a scrolling camera that only
+//   draws what it sees
+
+#include <memory>
+#include <algorithm>
+#include <limits>
+#include <cmath>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <new>
+#include <functional>
+#include <iterator>
+#include <tuple>
+#include <typeinfo>
+#include <utility>
+#include <type_traits>
+#include <SFML/Graphics.hpp>
+#include "perf_counters.hpp"
+
+constexpr unsigned int wndWidth{800}, wndHeight{600};
+
+// The world can be bigger than the window: the camera scrolls over it.
+// `ARKANOID_WORLD_SCREENS` sets its height, in windows.
+#ifndef ARKANOID_WORLD_SCREENS
+#define ARKANOID_WORLD_SCREENS 2
+#endif
+
+constexpr unsigned int worldWidth{wndWidth};
+constexpr unsigned int worldHeight{wndHeight * ARKANOID_WORLD_SCREENS};
+
+// Optional instrumentation:
+// * `ARKANOID_TRACK_ALLOCATIONS` counts allocations per frame phase.
+// * `ARKANOID_PERF_COUNTERS` reads hardware counters per frame phase.
+// * `ARKANOID_SAMPLING_PROFILER` samples call stacks per frame phase.
+// * `ARKANOID_ALLOCATION_CHECK` runs the allocation check (see the end
+//   of the file), which needs allocations to be tracked.
+// * `ARKANOID_SOAK` runs a long headless session instead of the game,
+//   for instance to sample it with the profiler.
+#if defined(ARKANOID_ALLOCATION_CHECK) && !defined(ARKANOID_TRACK_ALLOCATIONS)
+#define ARKANOID_TRACK_ALLOCATIONS
+#endif
+
+#ifdef ARKANOID_SAMPLING_PROFILER
+#include "sampling_profiler.hpp"
+#endif
+
+// Counters of the global allocation functions. They are only updated
+// when compiling with `ARKANOID_TRACK_ALLOCATIONS`, which replaces
+// `operator new` and `operator delete`. The game is single-threaded,
+// so plain integers are enough.
+struct AllocationCounters
+{
+    std::size_t allocations{0}, allocatedBytes{0}, liveBytes{0};
+};
+
+AllocationCounters allocationCounters;
+
+#ifdef ARKANOID_TRACK_ALLOCATIONS
+// The size of every block is stored in a header in front of it, so
+// that `operator delete` can keep `liveBytes` up to date. The operators
+// are never inlined: compilers would otherwise see `std::free` called
+// on pointers returned by `operator new`, and warn about it.
+constexpr std::size_t allocationHeader{alignof(std::max_align_t)};
+
+__attribute__((noinline)) void* operator new(std::size_t mSize)
+{
+    auto ptr(static_cast<char*>(std::malloc(mSize + allocationHeader)));
+    if(ptr == nullptr) throw std::bad_alloc{};
+
+    *reinterpret_cast<std::size_t*>(ptr) = mSize;
+
+    ++allocationCounters.allocations;
+    allocationCounters.allocatedBytes += mSize;
+    allocationCounters.liveBytes += mSize;
+
+    return ptr + allocationHeader;
+}
+
+__attribute__((noinline)) void operator delete(void* mPtr) noexcept
+{
+    if(mPtr == nullptr) return;
+
+    auto ptr(static_cast<char*>(mPtr) - allocationHeader);
+    allocationCounters.liveBytes -= *reinterpret_cast<std::size_t*>(ptr);
+    std::free(ptr);
+}
+
+__attribute__((noinline)) void operator delete(
+    void* mPtr, std::size_t) noexcept
+{
+    operator delete(mPtr);
+}
+#endif
+
+// Every entity type gets a unique, dense id the first time it is used.
+// Unlike `typeid(T).hash_code()`, ids cannot collide, and they can
+// directly index a vector of groups.
+using TypeId = std::size_t;
+
+inline TypeId getNextTypeId() noexcept
+{
+    static TypeId next{0};
+    return next++;
+}
+
+template <typename T>
+TypeId getTypeId() noexcept
+{
+    static TypeId id{getNextTypeId()};
+    return id;
+}
+
+template <typename... Ts>
+struct TypeList
+{
+};
+
+class Entity
+{
+public:
+    bool destroyed{false};
+
+    // Sleeping entities are skipped by `Manager::update`. Entities may
+    // start asleep and fall asleep at any time, but must be woken up
+    // through the manager.
+    bool sleeping{false};
+
+    // Kept in sync by the manager.
+    TypeId typeId{0};
+    bool awakeListed{false};
+
+    virtual ~Entity() {}
+    virtual void update() {}
+    virtual void draw(sf::RenderWindow& mTarget) {}
+    virtual std::uint64_t getRenderKey() const noexcept { return 0; }
+};
+
+// Entities derived from `EntityBase<TDerived>` implement non-virtual
+// `onUpdate` and `onDraw` functions. The manager calls them directly
+// (and can inline them) for the types it is told about statically,
+// while code that only knows `Entity`, and plugin-defined types that
+// override `update` and `draw`, keep using the virtual functions.
+template <typename TDerived>
+class EntityBase : public Entity
+{
+private:
+    TDerived& derived() noexcept { return static_cast<TDerived&>(*this); }
+
+    const TDerived& derived() const noexcept
+    {
+        return static_cast<const TDerived&>(*this);
+    }
+
+public:
+    void onUpdate() {}
+    void onDraw(sf::RenderWindow&) {}
+    std::uint64_t renderKey() const noexcept { return 0; }
+
+    void update() final { derived().onUpdate(); }
+    void draw(sf::RenderWindow& mTarget) final { derived().onDraw(mTarget); }
+    std::uint64_t getRenderKey() const noexcept final
+    {
+        return derived().renderKey();
+    }
+};
+
+// Draws are sorted by a 64-bit key: layer first, then material (such
+// as a texture or a colour), then shape type, then depth. Consecutive
+// draws then share as much render state as possible.
+enum class ShapeType : std::uint8_t
+{
+    Rectangle,
+    Circle
+};
+
+constexpr std::uint64_t makeRenderKey(std::uint8_t mLayer,
+    std::uint16_t mMaterial, ShapeType mShape, std::uint32_t mDepth) noexcept
+{
+    return std::uint64_t(mLayer) << 56 | std::uint64_t(mMaterial) << 40 |
+           std::uint64_t(mShape) << 32 | mDepth;
+}
+
+// A buffer of draw commands, reused every frame, and sorted by key with
+// a stable LSD radix sort: one pass per byte, skipping the bytes every
+// key shares. Most keys only differ in a couple of bytes. Every command
+// draws its entity through a function instantiated for its type, so
+// that `EntityBase` types are drawn without virtual calls.
+class RenderQueue
+{
+private:
+    using DrawFunc = void (*)(Entity&, sf::RenderWindow&);
+
+    struct Command
+    {
+        std::uint64_t key;
+        Entity* entity;
+        DrawFunc draw;
+    };
+
+    static constexpr std::size_t keyBytes{sizeof(std::uint64_t)};
+
+    std::vector<Command> commands, sorted;
+    std::array<std::array<std::uint32_t, 256>, keyBytes> counts;
+
+    static std::size_t getByte(std::uint64_t mKey, std::size_t mI) noexcept
+    {
+        return (mKey >> (mI * 8)) & 0xFF;
+    }
+
+public:
+    void clear() noexcept { commands.clear(); }
+
+    std::size_t getBytes() const noexcept
+    {
+        return (commands.capacity() + sorted.capacity()) * sizeof(Command);
+    }
+
+    // Draws `mEntity` through `Entity::draw`.
+    void push(std::uint64_t mKey, Entity& mEntity)
+    {
+        commands.push_back({mKey, &mEntity,
+            [](Entity& mE, sf::RenderWindow& mTarget)
+            {
+                mE.draw(mTarget);
+            }});
+    }
+
+    // Draws `mEntity` through `T::onDraw`.
+    template <typename T>
+    void pushStatic(std::uint64_t mKey, T& mEntity)
+    {
+        commands.push_back({mKey, &mEntity,
+            [](Entity& mE, sf::RenderWindow& mTarget)
+            {
+                static_cast<T&>(mE).onDraw(mTarget);
+            }});
+    }
+
+    void sort()
+    {
+        if(commands.empty()) return;
+
+        for(auto& count : counts) count.fill(0);
+        for(const auto& c : commands)
+            for(std::size_t i{0}; i < keyBytes; ++i)
+                ++counts[i][getByte(c.key, i)];
+
+        sorted.resize(commands.size());
+        for(std::size_t i{0}; i < keyBytes; ++i)
+        {
+            auto& count(counts[i]);
+            if(count[getByte(commands[0].key, i)] == commands.size())
+                continue;
+
+            std::uint32_t offset{0};
+            for(auto& c : count)
+            {
+                auto n(c);
+                c = offset;
+                offset += n;
+            }
+
+            for(const auto& c : commands)
+                sorted[count[getByte(c.key, i)]++] = c;
+
+            commands.swap(sorted);
+        }
+    }
+
+    void draw(sf::RenderWindow& mTarget)
+    {
+        for(const auto& c : commands) c.draw(*c.entity, mTarget);
+    }
+};
+
+// A lightweight, non-owning view over a group of entities of type `T`
+// (possibly `const`-qualified). Creating and iterating it never
+// allocates.
+template <typename T>
+class GroupView
+{
+private:
+    using Ptr = Entity* const*;
+    Ptr first, last;
+
+public:
+    class Iterator
+    {
+    private:
+        Ptr ptr;
+
+    public:
+        Iterator(Ptr mPtr) noexcept : ptr{mPtr} {}
+
+        T& operator*() const noexcept { return *static_cast<T*>(*ptr); }
+        Iterator& operator++() noexcept
+        {
+            ++ptr;
+            return *this;
+        }
+        bool operator!=(const Iterator& mRhs) const noexcept
+        {
+            return ptr != mRhs.ptr;
+        }
+    };
+
+    GroupView(Ptr mFirst, Ptr mLast) noexcept : first{mFirst}, last{mLast}
+    {
+    }
+
+    Iterator begin() const noexcept { return first; }
+    Iterator end() const noexcept { return last; }
+    std::size_t size() const noexcept { return last - first; }
+    bool empty() const noexcept { return first == last; }
+};
+
+template <typename T1, typename T2>
+bool isIntersecting(const T1& mA, const T2& mB) noexcept
+{
+    return mA.right() >= mB.left() && mA.left() <= mB.right() &&
+           mA.bottom() >= mB.top() && mA.top() <= mB.bottom();
+}
+
+// An axis-aligned area of the world, such as the one seen by the
+// camera.
+struct Bounds
+{
+    float minX, minY, maxX, maxY;
+
+    float left() const noexcept { return minX; }
+    float right() const noexcept { return maxX; }
+    float top() const noexcept { return minY; }
+    float bottom() const noexcept { return maxY; }
+};
+
+// A broadphase generates candidate pairs between two groups: every
+// overlapping pair is yielded exactly once, possibly along with some
+// pairs that don't overlap. Handlers still run their exact test.
+namespace broadphase
+{
+    // Every combination: the best choice for tiny groups.
+    struct BruteForce
+    {
+        template <typename TA, typename TB, typename TFunc>
+        void operator()(
+            GroupView<TA> mAs, GroupView<TB> mBs, const TFunc& mFunc) const
+        {
+            for(auto& a : mAs)
+                for(auto& b : mBs) mFunc(a, b);
+        }
+    };
+
+    // A uniform grid of the `TB` entities, rebuilt on every call by
+    // counting sort into buffers reused across calls. Entities spanning
+    // several cells are stored in each of them: a pair is only yielded
+    // from the cell containing the top-left corner of its overlap.
+    // Built once, a grid can also be queried for the entities in any
+    // area, and entities that didn't move can be removed from it.
+    class Grid
+    {
+    private:
+        static constexpr float minCellSize{64.f};
+
+        // The entries of a cell start at `cellStarts[i]`, and end at
+        // `cellEnds[i]`, which removals move back.
+        float originX, originY, cellSize;
+        int columns{0}, rows{0};
+        std::vector<std::uint32_t> cellStarts, cellEnds;
+        std::vector<Entity*> cellEntries;
+
+        int getColumn(float mX) const noexcept
+        {
+            return std::max(0,
+                std::min(columns - 1, int((mX - originX) / cellSize)));
+        }
+
+        int getRow(float mY) const noexcept
+        {
+            return std::max(
+                0, std::min(rows - 1, int((mY - originY) / cellSize)));
+        }
+
+        template <typename TArea, typename TFunc>
+        void forEachCellOf(const TArea& mArea, const TFunc& mFunc) const
+        {
+            for(int iY{getRow(mArea.top())}; iY <= getRow(mArea.bottom());
+                ++iY)
+                for(int iX{getColumn(mArea.left())};
+                    iX <= getColumn(mArea.right()); ++iX)
+                    mFunc(iX, iY, iX + iY * columns);
+        }
+
+    public:
+        // `mBs` must not be empty.
+        template <typename TB>
+        void build(GroupView<TB> mBs)
+        {
+            auto minX(std::numeric_limits<float>::max()), minY(minX);
+            auto maxX(std::numeric_limits<float>::lowest()), maxY(maxX);
+
+            for(auto& b : mBs)
+            {
+                minX = std::min(minX, b.left());
+                minY = std::min(minY, b.top());
+                maxX = std::max(maxX, b.right());
+                maxY = std::max(maxY, b.bottom());
+            }
+
+            // Cells grow with sparse fields, so that there are never
+            // many more cells than entities.
+            originX = minX;
+            originY = minY;
+            cellSize = minCellSize;
+
+            auto maxCells(4 * double(mBs.size()) + 16);
+            do
+            {
+                columns = int((maxX - minX) / cellSize) + 1;
+                rows = int((maxY - minY) / cellSize) + 1;
+                cellSize *= 2.f;
+            } while(double(columns) * rows > maxCells);
+            cellSize /= 2.f;
+
+            auto cells(std::size_t(columns) * rows);
+            cellStarts.assign(cells + 1, 0);
+            for(auto& b : mBs)
+                forEachCellOf(b, [this](int, int, int mCell)
+                    {
+                        ++cellStarts[mCell + 1];
+                    });
+
+            for(std::size_t i{0}; i < cells; ++i)
+                cellStarts[i + 1] += cellStarts[i];
+
+            cellEnds.assign(cellStarts.begin(), cellStarts.end() - 1);
+            cellEntries.resize(cellStarts.back());
+            for(auto& b : mBs)
+                forEachCellOf(b, [this, &b](int, int, int mCell)
+                    {
+                        cellEntries[cellEnds[mCell]++] = &b;
+                    });
+        }
+
+        // Removes `mB` from its cells, in a few steps per cell. It must
+        // not have moved since the last build. The other entries keep
+        // their order, as if the grid had been rebuilt without `mB`.
+        template <typename TB>
+        void remove(TB& mB) noexcept
+        {
+            Entity* ptr(&mB);
+            forEachCellOf(mB, [this, ptr](int, int, int mCell)
+                {
+                    auto first(cellEntries.begin() + cellStarts[mCell]);
+                    auto last(cellEntries.begin() + cellEnds[mCell]);
+
+                    auto it(std::find(first, last, ptr));
+                    if(it == last) return;
+
+                    std::copy(it + 1, last, it);
+                    --cellEnds[mCell];
+                });
+        }
+
+        std::size_t getBytes() const noexcept
+        {
+            return (cellStarts.capacity() + cellEnds.capacity()) *
+                       sizeof(std::uint32_t) +
+                   cellEntries.capacity() * sizeof(Entity*);
+        }
+
+        // Calls `mFunc(b)` once for every entity of the last build
+        // intersecting `mArea`.
+        template <typename TB, typename TArea, typename TFunc>
+        void query(const TArea& mArea, const TFunc& mFunc) const
+        {
+            forEachCellOf(mArea, [this, &mArea, &mFunc](
+                                     int mX, int mY, int mCell)
+                {
+                    for(auto i(cellStarts[mCell]); i < cellEnds[mCell]; ++i)
+                    {
+                        auto& b(static_cast<TB&>(*cellEntries[i]));
+                        if(!isIntersecting(mArea, b)) continue;
+
+                        if(getColumn(std::max(mArea.left(), b.left())) ==
+                                mX &&
+                            getRow(std::max(mArea.top(), b.top())) == mY)
+                            mFunc(b);
+                    }
+                });
+        }
+
+        template <typename TA, typename TB, typename TFunc>
+        void operator()(
+            GroupView<TA> mAs, GroupView<TB> mBs, const TFunc& mFunc)
+        {
+            if(mAs.empty() || mBs.empty()) return;
+            build(mBs);
+
+            for(auto& a : mAs)
+                query<TB>(a, [&a, &mFunc](TB& mB)
+                    {
+                        mFunc(a, mB);
+                    });
+        }
+    };
+
+    // Sweep and prune along the x axis: both groups are sorted by their
+    // left edge, and each entity is only tested against the entities of
+    // the other group whose x interval is still open.
+    class SweepAndPrune
+    {
+    private:
+        std::vector<Entity*> sortedAs, sortedBs, activeAs, activeBs;
+
+        template <typename T>
+        static void sortByLeft(
+            std::vector<Entity*>& mSorted, GroupView<T> mView)
+        {
+            mSorted.clear();
+            for(auto& e : mView) mSorted.emplace_back(&e);
+
+            std::sort(std::begin(mSorted), std::end(mSorted),
+                [](auto mA, auto mB)
+                {
+                    return static_cast<T*>(mA)->left() <
+                           static_cast<T*>(mB)->left();
+                });
+        }
+
+        // Closes the intervals ending before `mLeft`.
+        template <typename T>
+        static void prune(std::vector<Entity*>& mActive, float mLeft)
+        {
+            for(std::size_t i{0}; i < mActive.size();)
+                if(static_cast<T*>(mActive[i])->right() < mLeft)
+                {
+                    mActive[i] = mActive.back();
+                    mActive.pop_back();
+                }
+                else
+                    ++i;
+        }
+
+        template <typename T1, typename T2>
+        static bool overlapsY(const T1& mA, const T2& mB) noexcept
+        {
+            return mA.bottom() >= mB.top() && mA.top() <= mB.bottom();
+        }
+
+    public:
+        template <typename TA, typename TB, typename TFunc>
+        void operator()(
+            GroupView<TA> mAs, GroupView<TB> mBs, const TFunc& mFunc)
+        {
+            sortByLeft(sortedAs, mAs);
+            sortByLeft(sortedBs, mBs);
+            activeAs.clear();
+            activeBs.clear();
+
+            auto itA(std::begin(sortedAs)), itB(std::begin(sortedBs));
+            while(itA != std::end(sortedAs) || itB != std::end(sortedBs))
+            {
+                if(itB == std::end(sortedBs) ||
+                    (itA != std::end(sortedAs) &&
+                        static_cast<TA*>(*itA)->left() <=
+                            static_cast<TB*>(*itB)->left()))
+                {
+                    auto& a(static_cast<TA&>(**itA++));
+                    prune<TB>(activeBs, a.left());
+
+                    for(auto e : activeBs)
+                    {
+                        auto& b(static_cast<TB&>(*e));
+                        if(overlapsY(a, b)) mFunc(a, b);
+                    }
+
+                    activeAs.emplace_back(&a);
+                }
+                else
+                {
+                    auto& b(static_cast<TB&>(**itB++));
+                    prune<TA>(activeAs, b.left());
+
+                    for(auto e : activeAs)
+                    {
+                        auto& a(static_cast<TA&>(*e));
+                        if(overlapsY(a, b)) mFunc(a, b);
+                    }
+
+                    activeBs.emplace_back(&b);
+                }
+            }
+        }
+    };
+
+    // Each `TA` queries the manager's spatial index of the `TB`
+    // entities (see `SpatialIndexFor`), which is only rebuilt after
+    // `TB` entities are created: the best choice against many entities
+    // that never move.
+    struct Indexed
+    {
+    };
+}
+
+// The broadphase used by `Manager::forEachPair` for a pair of types,
+// chosen at compile time. Specialize it to pick another strategy.
+template <typename TA, typename TB>
+struct BroadphaseFor
+{
+    using Type = broadphase::BruteForce;
+};
+
+// Storage policies own the memory of the entities of one type. They
+// all give entities a stable address, as groups and handlers keep
+// pointers to them.
+namespace storage
+{
+    // Slots are the entities the storage can hold without allocating,
+    // live or not. Bytes include the storage itself, but not allocator
+    // headers.
+    struct Usage
+    {
+        std::size_t slots, bytes;
+    };
+
+    class Base
+    {
+    public:
+        virtual ~Base() {}
+
+        // Destroys `mEntity`, which must have been created by this
+        // storage.
+        virtual void release(Entity* mEntity) noexcept = 0;
+
+        virtual Usage getUsage() const noexcept = 0;
+    };
+
+    // One heap allocation per entity.
+    template <typename T>
+    class Heap : public Base
+    {
+    private:
+        std::size_t live{0};
+
+    public:
+        template <typename... TArgs>
+        T* create(TArgs&&... mArgs)
+        {
+            auto ptr(new T(std::forward<TArgs>(mArgs)...));
+            ++live;
+            return ptr;
+        }
+
+        void reserve(std::size_t) noexcept {}
+
+        void release(Entity* mEntity) noexcept override
+        {
+            delete static_cast<T*>(mEntity);
+            --live;
+        }
+
+        Usage getUsage() const noexcept override
+        {
+            return {live, sizeof(*this) + live * sizeof(T)};
+        }
+    };
+
+    // Fixed-size chunks of slots, with a free list: released slots are
+    // reused by the next entities, and chunks are never given back.
+    template <typename T, std::size_t TChunkSize = 256>
+    class Pool : public Base
+    {
+    private:
+        using Slot = std::aligned_storage_t<sizeof(T), alignof(T)>;
+
+        std::vector<std::unique_ptr<Slot[]>> chunks;
+        std::vector<Slot*> freeSlots;
+        std::size_t capacity{0};
+
+        // Chunks hold at least `TChunkSize` slots.
+        void grow(std::size_t mCount)
+        {
+            auto size(std::max(mCount, TChunkSize));
+            chunks.emplace_back(new Slot[size]);
+            capacity += size;
+
+            // Reserving every slot means `release` never allocates.
+            freeSlots.reserve(capacity);
+            for(auto i(size); i > 0; --i)
+                freeSlots.emplace_back(&chunks.back()[i - 1]);
+        }
+
+    public:
+        template <typename... TArgs>
+        T* create(TArgs&&... mArgs)
+        {
+            if(freeSlots.empty()) grow(TChunkSize);
+
+            auto ptr(new(freeSlots.back()) T(std::forward<TArgs>(mArgs)...));
+            freeSlots.pop_back();
+            return ptr;
+        }
+
+        void release(Entity* mEntity) noexcept override
+        {
+            auto ptr(static_cast<T*>(mEntity));
+            ptr->~T();
+            freeSlots.emplace_back(reinterpret_cast<Slot*>(ptr));
+        }
+
+        // Makes room for `mCount` more entities in a single chunk.
+        void reserve(std::size_t mCount)
+        {
+            if(freeSlots.size() < mCount) grow(mCount - freeSlots.size());
+        }
+
+        Usage getUsage() const noexcept override
+        {
+            return {capacity,
+                sizeof(*this) + capacity * sizeof(Slot) +
+                    freeSlots.capacity() * sizeof(Slot*) +
+                    chunks.capacity() * sizeof(chunks[0])};
+        }
+    };
+
+    // A single slot, stored inline. Like a failed allocation, creating
+    // a second live instance throws `std::bad_alloc`.
+    template <typename T>
+    class Singleton : public Base
+    {
+    private:
+        std::aligned_storage_t<sizeof(T), alignof(T)> slot;
+        bool occupied{false};
+
+    public:
+        template <typename... TArgs>
+        T* create(TArgs&&... mArgs)
+        {
+            if(occupied) throw std::bad_alloc{};
+
+            auto ptr(new(&slot) T(std::forward<TArgs>(mArgs)...));
+            occupied = true;
+            return ptr;
+        }
+
+        void reserve(std::size_t) noexcept {}
+
+        void release(Entity* mEntity) noexcept override
+        {
+            static_cast<T*>(mEntity)->~T();
+            occupied = false;
+        }
+
+        Usage getUsage() const noexcept override
+        {
+            return {1, sizeof(*this)};
+        }
+    };
+}
+
+// Memory and occupancy of a type group. Destroyed entities still hold
+// their slot until the next refresh. Free slots are held by the storage
+// without being used: for pools, they measure fragmentation. Bytes
+// include the group's lists, storage and spatial index.
+struct GroupStats
+{
+    const char* name;
+    std::size_t live, destroyed, peak;
+    std::size_t listCapacity, slots, indexBytes, bytes;
+};
+
+// Bytes are everything the manager allocated, without allocator
+// headers: its groups, its render queue, and its tables indexed by
+// type.
+struct ManagerStats
+{
+    std::size_t entities, entitiesCapacity, peak;
+    std::size_t renderQueueBytes, typeTablesBytes, bytes;
+    std::vector<GroupStats> groups;
+
+    void write(std::FILE* mFile) const
+    {
+        std::fprintf(mFile,
+            "{\"entities\": %zu, \"entities_capacity\": %zu, "
+            "\"peak\": %zu, \"render_queue_bytes\": %zu, "
+            "\"type_tables_bytes\": %zu, \"bytes\": %zu, \"groups\": [",
+            entities, entitiesCapacity, peak, renderQueueBytes,
+            typeTablesBytes, bytes);
+
+        for(std::size_t i{0}; i < groups.size(); ++i)
+        {
+            const auto& g(groups[i]);
+            auto used(g.live + g.destroyed);
+            auto freeSlots(g.slots - std::min(g.slots, used));
+
+            std::fprintf(mFile,
+                "%s\n  {\"type\": \"%s\", \"live\": %zu, "
+                "\"destroyed\": %zu, \"peak\": %zu, "
+                "\"list_capacity\": %zu, \"slots\": %zu, "
+                "\"free_slots\": %zu, \"fragmentation\": %.3f, "
+                "\"index_bytes\": %zu, \"bytes\": %zu}",
+                i == 0 ? "" : ",", g.name, g.live, g.destroyed, g.peak,
+                g.listCapacity, g.slots, freeSlots,
+                g.slots == 0 ? 0. : double(freeSlots) / g.slots,
+                g.indexBytes, g.bytes);
+        }
+
+        std::fprintf(mFile, "\n]}\n");
+    }
+};
+
+// The storage policy of every entity type, chosen at compile time.
+// Specialize it to pick another policy.
+template <typename T>
+struct StorageFor
+{
+    using Type = storage::Heap<T>;
+};
+
+// Entities of a type are updated once every `value` ticks. Slower
+// tiers are staggered: every tick updates the same share of their
+// entities, whose update should account for the elapsed ticks.
+template <typename T>
+struct UpdateRateFor
+{
+    static constexpr std::size_t value{1};
+};
+
+template <typename T>
+constexpr std::size_t UpdateRateFor<T>::value;
+
+// Whether area queries on a type (such as camera culling) go through a
+// grid of its entities, instead of testing them one by one. The grid
+// is rebuilt after entities are created, while destroyed entities are
+// removed from their cells by `refresh`: it suits many entities that
+// never move.
+template <typename T>
+struct SpatialIndexFor
+{
+    static constexpr bool value{false};
+};
+
+// Managers can also be given a whole different set of policies, for
+// instance to compare them in benchmarks.
+template <template <typename> class TStorageFor>
+class BasicManager
+{
+private:
+    // Every entity, in creation order. Entities are owned by the
+    // storage of their type.
+    std::vector<Entity*> entities;
+
+    // Groups are indexed by `TypeId`. Querying a type that was never
+    // created does not add a group.
+    std::vector<std::vector<Entity*>> groupedEntities;
+    std::vector<std::unique_ptr<storage::Base>> storages;
+
+    // Entities to update, indexed by `TypeId`: update costs scale with
+    // awake entities only. New and woken entities wait in
+    // `pendingAwake` until the next update, so that updates can create
+    // or wake entities safely. Every type has one bucket per tick of
+    // its update rate (see `UpdateRateFor`), and every tick updates
+    // one of them.
+    using Buckets = std::vector<std::vector<Entity*>>;
+
+    std::vector<Buckets> awakeEntities;
+    std::vector<Entity*> pendingAwake;
+    std::size_t updateTick{0};
+
+    RenderQueue renderQueue;
+
+    // Spatial indices, indexed by `TypeId`, flagged as stale when
+    // entities are created. Only used by types with `SpatialIndexFor`,
+    // which have a function removing their entities from the index.
+    using IndexRemover = void (*)(broadphase::Grid&, Entity&);
+
+    std::vector<broadphase::Grid> spatialIndices;
+    std::vector<bool> staleIndices;
+    std::vector<IndexRemover> indexRemovers;
+
+    // Type names and peak sizes, for statistics, indexed by `TypeId`.
+    std::vector<const char*> groupNames;
+    std::vector<std::size_t> groupPeaks;
+    std::size_t peakEntities{0};
+
+    // Callbacks invoked by `refresh` when the last entity of a type is
+    // removed, indexed by `TypeId`. They survive `clear`.
+    std::vector<std::function<void()>> onEmptyCallbacks;
+    std::vector<TypeId> emptiedGroups;
+
+    static void eraseDestroyed(std::vector<Entity*>& mVector)
+    {
+        mVector.erase(std::remove_if(std::begin(mVector), std::end(mVector),
+                          [](auto mPtr)
+                          {
+                              return mPtr->destroyed;
+                          }),
+            std::end(mVector));
+    }
+
+    template <typename T>
+    std::vector<Entity*>& getOrCreateGroup()
+    {
+        auto id(getTypeId<T>());
+        if(id >= groupedEntities.size())
+        {
+            groupedEntities.resize(id + 1);
+            awakeEntities.resize(id + 1);
+            groupNames.resize(id + 1, nullptr);
+            groupPeaks.resize(id + 1, 0);
+            spatialIndices.resize(id + 1);
+            staleIndices.resize(id + 1, true);
+            indexRemovers.resize(id + 1, nullptr);
+
+            // Every group can empty in the same refresh: reserving
+            // here means `refresh` never allocates.
+            emptiedGroups.reserve(id + 1);
+        }
+
+        constexpr std::size_t rate{UpdateRateFor<T>::value};
+        auto& buckets(awakeEntities[id]);
+        if(buckets.empty()) buckets.resize(rate > 1 ? rate : 1);
+
+        groupNames[id] = typeid(T).name();
+        indexRemovers[id] = getIndexRemover<T>(
+            std::integral_constant<bool, SpatialIndexFor<T>::value>{});
+        return groupedEntities[id];
+    }
+
+    template <typename T>
+    static IndexRemover getIndexRemover(std::true_type) noexcept
+    {
+        return [](broadphase::Grid& mIndex, Entity& mEntity)
+        {
+            mIndex.remove(static_cast<T&>(mEntity));
+        };
+    }
+
+    template <typename T>
+    static IndexRemover getIndexRemover(std::false_type) noexcept
+    {
+        return nullptr;
+    }
+
+    // Storages survive `reset`, so that pools keep their chunks.
+    template <typename T>
+    auto& getOrCreateStorage()
+    {
+        using Storage = typename TStorageFor<T>::Type;
+
+        auto id(getTypeId<T>());
+        if(id >= storages.size()) storages.resize(id + 1);
+
+        auto& storage(storages[id]);
+        if(storage == nullptr) storage = std::make_unique<Storage>();
+        return static_cast<Storage&>(*storage);
+    }
+
+    template <typename T, typename TTuple, std::size_t... TIs>
+    T& createFromTuple(const TTuple& mArgs, std::index_sequence<TIs...>)
+    {
+        return create<T>(std::get<TIs>(mArgs)...);
+    }
+
+    template <typename T>
+    const std::vector<Entity*>* findGroup() const noexcept
+    {
+        auto id(getTypeId<T>());
+        return id < groupedEntities.size() ? &groupedEntities[id] : nullptr;
+    }
+
+public:
+    BasicManager() = default;
+
+    BasicManager(const BasicManager&) = delete;
+    BasicManager& operator=(const BasicManager&) = delete;
+
+    ~BasicManager() { releaseAll(); }
+
+    template <typename T, typename... TArgs>
+    T& create(TArgs&&... mArgs)
+    {
+        static_assert(std::is_base_of<Entity, T>::value,
+            "`T` must be derived from `Entity`");
+
+        auto ptr(getOrCreateStorage<T>().create(std::forward<TArgs>(mArgs)...));
+        ptr->typeId = getTypeId<T>();
+
+        auto& group(getOrCreateGroup<T>());
+        group.emplace_back(ptr);
+        staleIndices[ptr->typeId] = true;
+        groupPeaks[ptr->typeId] =
+            std::max(groupPeaks[ptr->typeId], group.size());
+        entities.emplace_back(ptr);
+        peakEntities = std::max(peakEntities, entities.size());
+
+        if(!ptr->sleeping)
+        {
+            ptr->awakeListed = true;
+            pendingAwake.emplace_back(ptr);
+        }
+
+        return *ptr;
+    }
+
+    // Makes room for `mCount` more entities of type `T`, so that
+    // creating them reallocates neither their storage nor the lists of
+    // the manager.
+    template <typename T>
+    void reserve(std::size_t mCount)
+    {
+        auto& group(getOrCreateGroup<T>());
+        group.reserve(group.size() + mCount);
+        entities.reserve(entities.size() + mCount);
+        getOrCreateStorage<T>().reserve(mCount);
+    }
+
+    // Creates one `T` per element of `mArgs`, which are tuples of
+    // constructor arguments, after reserving room for all of them.
+    // Returns a view over the new entities.
+    template <typename T, typename TRange>
+    GroupView<T> createBulk(const TRange& mArgs)
+    {
+        std::size_t count(
+            std::distance(std::begin(mArgs), std::end(mArgs)));
+        reserve<T>(count);
+
+        for(const auto& args : mArgs)
+        {
+            using Tuple = std::decay_t<decltype(args)>;
+            createFromTuple<T>(args,
+                std::make_index_sequence<std::tuple_size<Tuple>::value>{});
+        }
+
+        const auto& group(getAll<T>());
+        auto last(group.data() + group.size());
+        return {last - count, last};
+    }
+
+    void sleep(Entity& mEntity) noexcept { mEntity.sleeping = true; }
+
+    void wake(Entity& mEntity)
+    {
+        mEntity.sleeping = false;
+        if(mEntity.awakeListed) return;
+
+        mEntity.awakeListed = true;
+        pendingAwake.emplace_back(&mEntity);
+    }
+
+    template <typename T, typename TFunc>
+    void onEmpty(TFunc&& mFunc)
+    {
+        auto id(getTypeId<T>());
+        if(id >= onEmptyCallbacks.size()) onEmptyCallbacks.resize(id + 1);
+        onEmptyCallbacks[id] = std::forward<TFunc>(mFunc);
+    }
+
+    void refresh()
+    {
+        for(auto& buckets : awakeEntities)
+            for(auto& vector : buckets) eraseDestroyed(vector);
+        eraseDestroyed(pendingAwake);
+        eraseDestroyed(entities);
+
+        // Destroyed entities are released last, by their storage. An
+        // up-to-date spatial index is kept so, instead of being rebuilt
+        // from the whole group.
+        for(TypeId id{0}; id < groupedEntities.size(); ++id)
+        {
+            auto& vector(groupedEntities[id]);
+            if(vector.empty()) continue;
+
+            auto removeFromIndex(
+                staleIndices[id] ? nullptr : indexRemovers[id]);
+
+            auto alive(std::begin(vector));
+            for(auto ptr : vector)
+                if(ptr->destroyed)
+                {
+                    if(removeFromIndex != nullptr)
+                        removeFromIndex(spatialIndices[id], *ptr);
+
+                    storages[id]->release(ptr);
+                }
+                else
+                    *alive++ = ptr;
+
+            if(alive == std::end(vector)) continue;
+
+            vector.erase(alive, std::end(vector));
+            if(vector.empty()) emptiedGroups.emplace_back(id);
+        }
+
+        // Callbacks run once the storage is consistent again, so that
+        // they can safely create new entities, even of new types, and
+        // register callbacks: both lists may grow, and are indexed
+        // again after every call. A running callback is moved out of
+        // its list, unless it replaced itself.
+        for(std::size_t i{0}; i < emptiedGroups.size(); ++i)
+        {
+            auto id(emptiedGroups[i]);
+            if(id >= onEmptyCallbacks.size() || !onEmptyCallbacks[id])
+                continue;
+
+            auto callback(std::move(onEmptyCallbacks[id]));
+            onEmptyCallbacks[id] = nullptr;
+            callback();
+
+            if(!onEmptyCallbacks[id])
+                onEmptyCallbacks[id] = std::move(callback);
+        }
+
+        emptiedGroups.clear();
+    }
+
+    // Destroys every entity, but keeps the groups, the capacity of
+    // every list and the storages' memory for the next entities: a
+    // restart doesn't need to allocate again.
+    void reset() noexcept
+    {
+        releaseAll();
+
+        for(auto& vector : groupedEntities) vector.clear();
+        for(auto& buckets : awakeEntities)
+            for(auto& vector : buckets) vector.clear();
+        pendingAwake.clear();
+        entities.clear();
+        staleIndices.assign(staleIndices.size(), true);
+    }
+
+    // Destroys every entity, and frees the memory of the manager's
+    // lists and storages.
+    void clear()
+    {
+        releaseAll();
+
+        groupedEntities.clear();
+        awakeEntities.clear();
+        storages.clear();
+        spatialIndices.clear();
+        staleIndices.clear();
+        indexRemovers.clear();
+        std::vector<Entity*>{}.swap(pendingAwake);
+        std::vector<Entity*>{}.swap(entities);
+    }
+
+    template <typename T>
+    const std::vector<Entity*>& getAll() const noexcept
+    {
+        static const std::vector<Entity*> none;
+
+        auto group(findGroup<T>());
+        return group != nullptr ? *group : none;
+    }
+
+    template <typename T>
+    GroupView<T> getView() noexcept
+    {
+        const auto& group(getAll<T>());
+        return {group.data(), group.data() + group.size()};
+    }
+
+    template <typename T>
+    GroupView<const T> getView() const noexcept
+    {
+        const auto& group(getAll<T>());
+        return {group.data(), group.data() + group.size()};
+    }
+
+    // Names are implementation-defined (`typeid(T).name()`). Counting
+    // destroyed entities scans every group: not meant for every frame.
+    ManagerStats getStats() const
+    {
+        ManagerStats stats{entities.size(), entities.capacity(),
+            peakEntities, renderQueue.getBytes(), getTypeTablesBytes(), 0,
+            {}};
+
+        stats.bytes = stats.renderQueueBytes + stats.typeTablesBytes +
+                      (entities.capacity() + pendingAwake.capacity()) *
+                          sizeof(Entity*);
+
+        for(TypeId id{0}; id < groupedEntities.size(); ++id)
+        {
+            const auto& vector(groupedEntities[id]);
+            if(groupNames[id] == nullptr) continue;
+
+            auto listCapacity(vector.capacity());
+            for(const auto& bucket : awakeEntities[id])
+                listCapacity += bucket.capacity();
+
+            GroupStats group{groupNames[id], vector.size(), 0,
+                groupPeaks[id], listCapacity, 0,
+                spatialIndices[id].getBytes(), 0};
+            group.bytes = group.indexBytes + listCapacity * sizeof(Entity*);
+
+            for(auto e : vector)
+                if(e->destroyed) ++group.destroyed;
+            group.live -= group.destroyed;
+
+            if(id < storages.size() && storages[id] != nullptr)
+            {
+                auto usage(storages[id]->getUsage());
+                group.slots = usage.slots;
+                group.bytes += usage.bytes;
+            }
+
+            stats.bytes += group.bytes;
+            stats.groups.emplace_back(group);
+        }
+
+        return stats;
+    }
+
+    // Both are O(1), and never allocate.
+    template <typename T>
+    std::size_t count() const noexcept
+    {
+        return getAll<T>().size();
+    }
+
+    template <typename T>
+    bool empty() const noexcept
+    {
+        return getAll<T>().empty();
+    }
+
+    template <typename T, typename TFunc>
+    void forEach(const TFunc& mFunc)
+    {
+        for(auto& e : getView<T>()) mFunc(e);
+    }
+
+    // Calls `mFunc(a, b)` for every candidate pair of a `TA` and a `TB`.
+    // The broadphase instance is shared by all managers, and keeps its
+    // buffers across calls, so that steady state passes don't allocate.
+    template <typename TA, typename TB,
+        typename TBroadphase = typename BroadphaseFor<TA, TB>::Type,
+        typename TFunc>
+    void forEachPair(const TFunc& mFunc)
+    {
+        forEachPairWith<TA, TB, TBroadphase>(
+            mFunc, std::is_same<TBroadphase, broadphase::Indexed>{});
+    }
+
+    // Calls `mFunc` for every `T` intersecting `mArea`, either through
+    // the type's spatial index or by testing every entity.
+    template <typename T, typename TArea, typename TFunc>
+    void forEachIn(const TArea& mArea, const TFunc& mFunc)
+    {
+        forEachIn<T>(mArea, mFunc,
+            std::integral_constant<bool, SpatialIndexFor<T>::value>{});
+    }
+
+    // Updates awake entities only, group after group.
+    void update()
+    {
+        mergePendingAwake();
+        for(TypeId id{0}; id < awakeEntities.size(); ++id)
+            forEachAwake<Entity>(id, [](Entity& mEntity)
+                {
+                    mEntity.update();
+                });
+
+        ++updateTick;
+    }
+
+    // Draws every entity, in render key order.
+    void draw(sf::RenderWindow& mTarget)
+    {
+        renderQueue.clear();
+        for(auto e : entities) renderQueue.push(e->getRenderKey(), *e);
+
+        renderQueue.sort();
+        renderQueue.draw(mTarget);
+    }
+
+    // Without virtual calls for the `EntityBase` types in `Ts`, group
+    // after group in the listed order; then through virtual calls for
+    // every other type.
+    template <typename... Ts>
+    void update(TypeList<Ts...>)
+    {
+        static_assert(areStatic<Ts...>(),
+            "`Ts` must be derived from `EntityBase<Ts>`");
+
+        mergePendingAwake();
+
+        using Expand = int[];
+        (void)Expand{0, (forEachAwake<Ts>(getTypeId<Ts>(), [](Ts& mEntity)
+                             {
+                                 mEntity.onUpdate();
+                             }),
+                            0)...};
+
+        for(TypeId id{0}; id < awakeEntities.size(); ++id)
+            if(!isListed<Ts...>(id))
+                forEachAwake<Entity>(id, [](Entity& mEntity)
+                    {
+                        mEntity.update();
+                    });
+
+        ++updateTick;
+    }
+
+    // The same, with render keys computed without virtual calls for
+    // the types in `Ts`.
+    template <typename... Ts>
+    void draw(sf::RenderWindow& mTarget, TypeList<Ts...> mTypes)
+    {
+        static_assert(areStatic<Ts...>(),
+            "`Ts` must be derived from `EntityBase<Ts>`");
+
+        renderQueue.clear();
+
+        using Expand = int[];
+        (void)Expand{0, (forEachStatic<Ts>([this](Ts& mEntity)
+                             {
+                                 queueDraw(mEntity);
+                             }),
+                            0)...};
+
+        queueDynamicDraws(mTypes);
+        drawQueue(mTarget);
+    }
+
+    // The same, culled: only the entities of `Ts` intersecting `mArea`
+    // are drawn. Other types have no known bounds, and are all drawn.
+    template <typename... Ts>
+    void draw(
+        sf::RenderWindow& mTarget, TypeList<Ts...> mTypes, const Bounds& mArea)
+    {
+        static_assert(areStatic<Ts...>(),
+            "`Ts` must be derived from `EntityBase<Ts>`");
+
+        renderQueue.clear();
+
+        using Expand = int[];
+        (void)Expand{0, (forEachIn<Ts>(mArea, [this](Ts& mEntity)
+                             {
+                                 queueDraw(mEntity);
+                             }),
+                            0)...};
+
+        queueDynamicDraws(mTypes);
+        drawQueue(mTarget);
+    }
+
+private:
+    template <typename TA, typename TB, typename TBroadphase,
+        typename TFunc>
+    void forEachPairWith(const TFunc& mFunc, std::false_type)
+    {
+        static TBroadphase broadphase;
+        broadphase(getView<TA>(), getView<TB>(), mFunc);
+    }
+
+    template <typename TA, typename TB, typename TBroadphase,
+        typename TFunc>
+    void forEachPairWith(const TFunc& mFunc, std::true_type)
+    {
+        static_assert(SpatialIndexFor<TB>::value,
+            "`TB` must have a spatial index");
+
+        for(auto& a : getView<TA>())
+            forEachIn<TB>(a, [&a, &mFunc](TB& mB)
+                {
+                    mFunc(a, mB);
+                });
+    }
+
+    template <typename T, typename TArea, typename TFunc>
+    void forEachIn(const TArea& mArea, const TFunc& mFunc, std::true_type)
+    {
+        if(empty<T>()) return;
+
+        auto id(getTypeId<T>());
+        auto& index(spatialIndices[id]);
+        if(staleIndices[id])
+        {
+            index.build(getView<T>());
+            staleIndices[id] = false;
+        }
+
+        index.template query<T>(mArea, mFunc);
+    }
+
+    template <typename T, typename TArea, typename TFunc>
+    void forEachIn(const TArea& mArea, const TFunc& mFunc, std::false_type)
+    {
+        for(auto& e : getView<T>())
+            if(isIntersecting(mArea, e)) mFunc(e);
+    }
+
+    template <typename T>
+    void queueDraw(T& mEntity)
+    {
+        renderQueue.pushStatic(mEntity.renderKey(), mEntity);
+    }
+
+    template <typename... Ts>
+    void queueDynamicDraws(TypeList<Ts...> mTypes)
+    {
+        forEachDynamic(mTypes, [this](Entity& mEntity)
+            {
+                renderQueue.push(mEntity.getRenderKey(), mEntity);
+            });
+    }
+
+    void drawQueue(sf::RenderWindow& mTarget)
+    {
+        renderQueue.sort();
+        renderQueue.draw(mTarget);
+    }
+
+    // The tables themselves, not what their elements own.
+    std::size_t getTypeTablesBytes() const noexcept
+    {
+        auto bytes(groupedEntities.capacity() * sizeof(groupedEntities[0]) +
+                   storages.capacity() * sizeof(storages[0]) +
+                   awakeEntities.capacity() * sizeof(Buckets) +
+                   spatialIndices.capacity() * sizeof(broadphase::Grid) +
+                   (staleIndices.capacity() + 7) / 8 +
+                   indexRemovers.capacity() * sizeof(IndexRemover) +
+                   groupNames.capacity() * sizeof(const char*) +
+                   groupPeaks.capacity() * sizeof(std::size_t) +
+                   onEmptyCallbacks.capacity() *
+                       sizeof(std::function<void()>) +
+                   emptiedGroups.capacity() * sizeof(TypeId));
+
+        for(const auto& buckets : awakeEntities)
+            bytes += buckets.capacity() * sizeof(buckets[0]);
+
+        return bytes;
+    }
+
+    void releaseAll() noexcept
+    {
+        for(TypeId id{0}; id < groupedEntities.size(); ++id)
+            for(auto ptr : groupedEntities[id]) storages[id]->release(ptr);
+    }
+
+    template <typename... Ts>
+    static constexpr bool areStatic() noexcept
+    {
+        const bool values[]{
+            true, std::is_base_of<EntityBase<Ts>, Ts>::value...};
+        for(auto value : values)
+            if(!value) return false;
+        return true;
+    }
+
+    template <typename... Ts>
+    static bool isListed(TypeId mId) noexcept
+    {
+        const TypeId ids[]{TypeId(-1), getTypeId<Ts>()...};
+        return std::find(std::begin(ids), std::end(ids), mId) != std::end(ids);
+    }
+
+    template <typename T, typename TFunc>
+    void forEachStatic(const TFunc& mFunc)
+    {
+        for(auto& e : getView<T>()) mFunc(e);
+    }
+
+    template <typename... Ts, typename TFunc>
+    void forEachDynamic(TypeList<Ts...>, const TFunc& mFunc)
+    {
+        for(TypeId id{0}; id < groupedEntities.size(); ++id)
+            if(!isListed<Ts...>(id))
+                for(auto e : groupedEntities[id]) mFunc(*e);
+    }
+
+    // Entities join the least loaded bucket of their type, and never
+    // leave it while awake: whatever is removed from the other buckets,
+    // they are updated exactly once every `rate` ticks.
+    void mergePendingAwake()
+    {
+        for(auto e : pendingAwake)
+        {
+            auto& buckets(awakeEntities[e->typeId]);
+            std::min_element(std::begin(buckets), std::end(buckets),
+                [](const auto& mA, const auto& mB)
+                {
+                    return mA.size() < mB.size();
+                })->emplace_back(e);
+        }
+
+        pendingAwake.clear();
+    }
+
+    // Updates the bucket of the current tick. Entities put to sleep
+    // since its last update leave it here.
+    template <typename T, typename TFunc>
+    void forEachAwake(TypeId mId, const TFunc& mFunc)
+    {
+        if(mId >= awakeEntities.size() || awakeEntities[mId].empty()) return;
+
+        auto& buckets(awakeEntities[mId]);
+        auto& vector(buckets[updateTick % buckets.size()]);
+
+        auto awake(std::begin(vector));
+        for(auto e : vector)
+            if(e->sleeping)
+                e->awakeListed = false;
+            else
+            {
+                *awake++ = e;
+                mFunc(static_cast<T&>(*e));
+            }
+
+        vector.erase(awake, std::end(vector));
+    }
+};
+
+using Manager = BasicManager<StorageFor>;
+
+// Every `sf::Shape` carries a vertex array, outline geometry, texture
+// pointers and a transform: storing one per entity makes a brick
+// hundreds of bytes big. Our entities will only store their logical
+// state (position, size/radius, colour) - every entity type will have
+// a single shared "prototype" shape, transformed right before drawing.
+sf::RectangleShape makeRectanglePrototype(
+    const sf::Vector2f& mSize, const sf::Color& mColor = sf::Color::White)
+{
+    sf::RectangleShape result{mSize};
+    result.setOrigin(mSize.x / 2.f, mSize.y / 2.f);
+    result.setFillColor(mColor);
+    return result;
+}
+
+sf::CircleShape makeCirclePrototype(
+    float mRadius, const sf::Color& mColor = sf::Color::White)
+{
+    sf::CircleShape result{mRadius};
+    result.setOrigin(mRadius, mRadius);
+    result.setFillColor(mColor);
+    return result;
+}
+
+struct Rectangle
+{
+    sf::Vector2f position, size;
+
+    float x() const noexcept { return position.x; }
+    float y() const noexcept { return position.y; }
+    float width() const noexcept { return size.x; }
+    float height() const noexcept { return size.y; }
+    float left() const noexcept { return x() - width() / 2.f; }
+    float right() const noexcept { return x() + width() / 2.f; }
+    float top() const noexcept { return y() - height() / 2.f; }
+    float bottom() const noexcept { return y() + height() / 2.f; }
+
+    // Draws the rectangle using a prototype shape created with
+    // `mDefSize`: the prototype is scaled to match our size.
+    void drawWith(sf::RenderWindow& mTarget, sf::RectangleShape& mPrototype,
+        const sf::Vector2f& mDefSize) const
+    {
+        mPrototype.setPosition(position);
+        mPrototype.setScale(size.x / mDefSize.x, size.y / mDefSize.y);
+        mTarget.draw(mPrototype);
+    }
+};
+
+struct Circle
+{
+    sf::Vector2f position;
+    float radius;
+
+    float x() const noexcept { return position.x; }
+    float y() const noexcept { return position.y; }
+    float left() const noexcept { return x() - radius; }
+    float right() const noexcept { return x() + radius; }
+    float top() const noexcept { return y() - radius; }
+    float bottom() const noexcept { return y() + radius; }
+
+    void drawWith(sf::RenderWindow& mTarget, sf::CircleShape& mPrototype,
+        float mDefRadius) const
+    {
+        mPrototype.setPosition(position);
+        mPrototype.setScale(radius / mDefRadius, radius / mDefRadius);
+        mTarget.draw(mPrototype);
+    }
+};
+
+class Ball : public EntityBase<Ball>, public Circle
+{
+public:
+    static const sf::Color defColor;
+    static constexpr float defRadius{10.f}, defVelocity{8.f};
+    static sf::CircleShape prototype;
+
+    sf::Vector2f velocity{-defVelocity, -defVelocity};
+
+    Ball(float mX, float mY)
+    {
+        position = {mX, mY};
+        radius = defRadius;
+    }
+
+    void onUpdate()
+    {
+        position += velocity;
+        solveBoundCollisions();
+    }
+
+    void onDraw(sf::RenderWindow& mTarget)
+    {
+        drawWith(mTarget, prototype, defRadius);
+    }
+
+    std::uint64_t renderKey() const noexcept
+    {
+        return makeRenderKey(2, 0, ShapeType::Circle, 0);
+    }
+
+private:
+    void solveBoundCollisions() noexcept
+    {
+        if(left() < 0)
+            velocity.x = defVelocity;
+        else if(right() > worldWidth)
+            velocity.x = -defVelocity;
+
+        if(top() < 0)
+            velocity.y = defVelocity;
+        else if(bottom() > worldHeight)
+        {
+            // If the ball leaves the world towards the bottom,
+            // we destroy it.
+            destroyed = true;
+        }
+    }
+};
+
+const sf::Color Ball::defColor{sf::Color::Red};
+sf::CircleShape Ball::prototype{makeCirclePrototype(defRadius, defColor)};
+
+// Keyboard state is sampled once per frame by the game: entities read
+// it from here instead of querying the OS, so that the simulation can
+// also run headless (e.g. in benchmarks).
+struct InputState
+{
+    bool left{false}, right{false};
+};
+
+class Paddle : public EntityBase<Paddle>, public Rectangle
+{
+public:
+    static const sf::Color defColor;
+    static constexpr float defWidth{60.f}, defHeight{20.f};
+    static constexpr float defVelocity{8.f};
+    static sf::RectangleShape prototype;
+
+    sf::Vector2f velocity;
+    const InputState* input;
+
+    Paddle(float mX, float mY, const InputState& mInput) : input{&mInput}
+    {
+        position = {mX, mY};
+        size = {defWidth, defHeight};
+    }
+
+    void onUpdate()
+    {
+        processPlayerInput();
+        position += velocity;
+    }
+
+    void onDraw(sf::RenderWindow& mTarget)
+    {
+        drawWith(mTarget, prototype, {defWidth, defHeight});
+    }
+
+    std::uint64_t renderKey() const noexcept
+    {
+        return makeRenderKey(1, 0, ShapeType::Rectangle, 0);
+    }
+
+private:
+    void processPlayerInput()
+    {
+        if(input->left && left() > 0)
+            velocity.x = -defVelocity;
+        else if(input->right && right() < worldWidth)
+            velocity.x = defVelocity;
+        else
+            velocity.x = 0;
+    }
+};
+
+const sf::Color Paddle::defColor{sf::Color::Red};
+sf::RectangleShape Paddle::prototype{
+    makeRectanglePrototype({defWidth, defHeight}, defColor)};
+
+class Brick : public EntityBase<Brick>, public Rectangle
+{
+public:
+    static const sf::Color defColorHits1;
+    static const sf::Color defColorHits2;
+    static const sf::Color defColorHits3;
+    static constexpr float defWidth{60.f}, defHeight{20.f};
+    static constexpr float defVelocity{8.f};
+    static constexpr int maxHits{3};
+    static sf::RectangleShape prototype;
+
+    // The required hits also act as the brick's colour index:
+    // there is no need to store an `sf::Color` per brick.
+    int requiredHits{1};
+
+    // Where the simulation's snapshots keep the brick's record.
+    int snapshotIndex{0};
+
+    Brick(float mX, float mY)
+    {
+        position = {mX, mY};
+        size = {defWidth, defHeight};
+
+        // Bricks never move: they are not updated at all.
+        sleeping = true;
+    }
+
+    // Bricks are sorted by colour, so that the prototype's colour only
+    // changes a few times per frame.
+    void onDraw(sf::RenderWindow& mTarget)
+    {
+        const auto& color(getColor());
+        if(prototype.getFillColor() != color) prototype.setFillColor(color);
+        drawWith(mTarget, prototype, {defWidth, defHeight});
+    }
+
+    std::uint64_t renderKey() const noexcept
+    {
+        return makeRenderKey(
+            0, std::min(requiredHits, maxHits), ShapeType::Rectangle, 0);
+    }
+
+    const sf::Color& getColor() const noexcept
+    {
+        if(requiredHits == 1) return defColorHits1;
+        if(requiredHits == 2) return defColorHits2;
+        return defColorHits3;
+    }
+};
+
+constexpr int Brick::maxHits;
+const sf::Color Brick::defColorHits1{255, 255, 0, 80};
+const sf::Color Brick::defColorHits2{255, 255, 0, 170};
+const sf::Color Brick::defColorHits3{255, 255, 0, 255};
+sf::RectangleShape Brick::prototype{
+    makeRectanglePrototype({defWidth, defHeight})};
+
+// The game's own entity types, updated and drawn without virtual
+// calls, in this order.
+using StaticEntities = TypeList<Brick, Ball, Paddle>;
+
+// Bricks are many and long-lived, balls are few but churn: both are
+// pooled. There is only ever one paddle.
+template <>
+struct StorageFor<Brick>
+{
+    using Type = storage::Pool<Brick>;
+};
+
+template <>
+struct StorageFor<Ball>
+{
+    using Type = storage::Pool<Ball>;
+};
+
+template <>
+struct StorageFor<Paddle>
+{
+    using Type = storage::Singleton<Paddle>;
+};
+
+// Bricks never move, and most of them are off-screen in tall levels:
+// the camera finds the visible ones through a grid.
+template <>
+struct SpatialIndexFor<Brick>
+{
+    static constexpr bool value{true};
+};
+
+// Balls only test the bricks around them, through the same grid: it is
+// only rebuilt after bricks are created, not when they are destroyed.
+template <>
+struct BroadphaseFor<Ball, Brick>
+{
+    using Type = broadphase::Indexed;
+};
+
+// Collision solvers only bounce the ball, and return whether there was
+// a hit: gameplay effects are applied later, from collision events.
+bool solvePaddleBallCollision(const Paddle& mPaddle, Ball& mBall) noexcept
+{
+    if(!isIntersecting(mPaddle, mBall)) return false;
+
+    mBall.velocity.y = -Ball::defVelocity;
+    mBall.velocity.x =
+        mBall.x() < mPaddle.x() ? -Ball::defVelocity : Ball::defVelocity;
+
+    return true;
+}
+
+bool solveBrickBallCollision(const Brick& mBrick, Ball& mBall) noexcept
+{
+    if(!isIntersecting(mBrick, mBall)) return false;
+
+    float overlapLeft{mBall.right() - mBrick.left()};
+    float overlapRight{mBrick.right() - mBall.left()};
+    float overlapTop{mBall.bottom() - mBrick.top()};
+    float overlapBottom{mBrick.bottom() - mBall.top()};
+
+    bool ballFromLeft(std::abs(overlapLeft) < std::abs(overlapRight));
+    bool ballFromTop(std::abs(overlapTop) < std::abs(overlapBottom));
+
+    float minOverlapX{ballFromLeft ? overlapLeft : overlapRight};
+    float minOverlapY{ballFromTop ? overlapTop : overlapBottom};
+
+    if(std::abs(minOverlapX) < std::abs(minOverlapY))
+        mBall.velocity.x =
+            ballFromLeft ? -Ball::defVelocity : Ball::defVelocity;
+    else
+        mBall.velocity.y = ballFromTop ? -Ball::defVelocity : Ball::defVelocity;
+
+    return true;
+}
+
+// Collisions are dispatched at compile time. Every collidable type is
+// assigned a layer, and every handled pair of types registers a
+// handler: pairs without a handler, or whose layers don't collide,
+// generate no code at all.
+using LayerMask = std::uint32_t;
+
+template <typename T>
+struct CollisionLayer;
+
+template <typename TA, typename TB>
+struct CollisionHandler
+{
+    static constexpr bool registered{false};
+};
+
+namespace Layer
+{
+    enum : std::size_t
+    {
+        Balls,
+        Bricks,
+        Paddles,
+        Count
+    };
+}
+
+// Every row is the mask of the layers the row's layer collides with.
+constexpr LayerMask layerMatrix[Layer::Count]{
+    (1u << Layer::Bricks) | (1u << Layer::Paddles), // Balls
+    0,                                              // Bricks
+    0                                               // Paddles
+};
+
+template <>
+struct CollisionLayer<Ball> : std::integral_constant<std::size_t, Layer::Balls>
+{
+};
+
+template <>
+struct CollisionLayer<Brick>
+    : std::integral_constant<std::size_t, Layer::Bricks>
+{
+};
+
+template <>
+struct CollisionLayer<Paddle>
+    : std::integral_constant<std::size_t, Layer::Paddles>
+{
+};
+
+// Hits are recorded as compact events in a buffer that is reused every
+// tick, and processed in a batch after the collision phase: the
+// collision loop itself runs no gameplay code.
+struct CollisionEvent
+{
+    enum class Type : std::uint8_t
+    {
+        BallBrick,
+        BallPaddle
+    };
+
+    Type type;
+    Entity *first, *second;
+};
+
+// Handlers receive a context (the simulation) to emit events to.
+template <>
+struct CollisionHandler<Ball, Brick>
+{
+    static constexpr bool registered{true};
+
+    template <typename TContext>
+    static void solve(Ball& mBall, Brick& mBrick, TContext& mContext)
+    {
+        if(solveBrickBallCollision(mBrick, mBall))
+            mContext.emit({CollisionEvent::Type::BallBrick, &mBall, &mBrick});
+    }
+};
+
+template <>
+struct CollisionHandler<Ball, Paddle>
+{
+    static constexpr bool registered{true};
+
+    template <typename TContext>
+    static void solve(Ball& mBall, Paddle& mPaddle, TContext& mContext)
+    {
+        if(solvePaddleBallCollision(mPaddle, mBall))
+            mContext.emit({CollisionEvent::Type::BallPaddle, &mBall, &mPaddle});
+    }
+};
+
+using Collidables = TypeList<Ball, Brick, Paddle>;
+
+template <typename TA, typename TB>
+constexpr bool collides() noexcept
+{
+    return CollisionHandler<TA, TB>::registered &&
+           (layerMatrix[CollisionLayer<TA>::value] &
+               (LayerMask{1} << CollisionLayer<TB>::value)) != 0;
+}
+
+template <typename TA, typename TB, typename TContext>
+void solvePair(Manager&, TContext&, std::false_type) noexcept
+{
+}
+
+template <typename TA, typename TB, typename TContext>
+void solvePair(Manager& mManager, TContext& mContext, std::true_type)
+{
+    mManager.forEachPair<TA, TB>([&mContext](TA& mA, TB& mB)
+        {
+            CollisionHandler<TA, TB>::solve(mA, mB, mContext);
+        });
+}
+
+template <typename TA, typename TContext, typename... TBs>
+void solvePairsWith(Manager& mManager, TContext& mContext, TypeList<TBs...>)
+{
+    using Expand = int[];
+    (void)Expand{0, (solvePair<TA, TBs>(mManager, mContext,
+                         std::integral_constant<bool, collides<TA, TBs>()>{}),
+                        0)...};
+}
+
+// Solves the collisions of every registered pair of `TTypes`.
+template <typename TContext, typename... TTypes>
+void solveCollisions(
+    Manager& mManager, TContext& mContext, TypeList<TTypes...> mTypes)
+{
+    using Expand = int[];
+    (void)Expand{
+        0, (solvePairsWith<TTypes>(mManager, mContext, mTypes), 0)...};
+}
+
+// The brick layout is shared by the game and the benchmarks, which
+// build much bigger brick fields from the same lattice.
+struct BrickLattice
+{
+    static constexpr int countX{11}, countY{4};
+    static constexpr int startColumn{1}, startRow{2};
+    static constexpr float spacing{3.f}, offsetX{22.f};
+
+    static sf::Vector2f getPosition(int mIX, int mIY) noexcept
+    {
+        return {offsetX + (mIX + startColumn) * (Brick::defWidth + spacing),
+            (mIY + startRow) * (Brick::defHeight + spacing)};
+    }
+
+    // Number of columns for a field of `mCount` bricks: the game's
+    // own field keeps its layout, bigger ones are roughly square.
+    static int getColumnsFor(std::size_t mCount) noexcept
+    {
+        if(mCount == std::size_t(countX * countY)) return countX;
+        return std::max(1, int(std::sqrt(mCount * 3.f)));
+    }
+};
+
+// Every frame is split in phases. The profiler records what happens
+// during every phase of the current frame, and accumulates it over the
+// whole run.
+enum class Phase : std::size_t
+{
+    Rules,
+    Update,
+    Collision,
+    Events,
+    Refresh,
+    Draw,
+    Count
+};
+
+constexpr std::size_t phaseCount{std::size_t(Phase::Count)};
+constexpr const char* phaseNames[phaseCount]{
+    "rules", "update", "collision", "events", "refresh", "draw"};
+
+// Fixed-memory histogram of durations, in nanoseconds. Like an HDR
+// histogram, every power of two is split in 32 linear sub-buckets, so
+// that any value is known with a relative error of about 3%. Recording
+// a value only takes a few instructions, and no allocations.
+class DurationHistogram
+{
+private:
+    static constexpr int subBucketBits{5};
+    static constexpr std::uint64_t subBuckets{1u << subBucketBits};
+    static constexpr std::size_t bucketCount{
+        (65 - subBucketBits) * subBuckets};
+
+    std::array<std::uint64_t, bucketCount> counts{};
+    std::uint64_t total{0}, max{0};
+
+    static std::size_t getIndex(std::uint64_t mValue) noexcept
+    {
+        if(mValue < subBuckets) return mValue;
+
+        int shift(63 - __builtin_clzll(mValue) - subBucketBits);
+        return (shift + 1) * subBuckets + ((mValue >> shift) - subBuckets);
+    }
+
+    // Returns the highest value that falls in the bucket `mIndex`.
+    static std::uint64_t getUpperBound(std::size_t mIndex) noexcept
+    {
+        if(mIndex < subBuckets) return mIndex;
+
+        auto shift(mIndex / subBuckets - 1);
+        auto subBucket(mIndex % subBuckets + subBuckets);
+        return ((subBucket + 1) << shift) - 1;
+    }
+
+public:
+    void record(std::uint64_t mNs) noexcept
+    {
+        ++counts[getIndex(mNs)];
+        ++total;
+        max = std::max(max, mNs);
+    }
+
+    void record(std::chrono::steady_clock::duration mDuration) noexcept
+    {
+        record(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            mDuration).count());
+    }
+
+    std::uint64_t getCount() const noexcept { return total; }
+    std::uint64_t getMax() const noexcept { return max; }
+
+    // Returns the value below which `mPercentile`% of the recorded
+    // values fall.
+    std::uint64_t getPercentile(double mPercentile) const noexcept
+    {
+        auto target(std::max<std::uint64_t>(
+            1, std::ceil(mPercentile / 100.0 * total)));
+
+        std::uint64_t seen{0};
+        for(std::size_t i{0}; i < bucketCount; ++i)
+        {
+            seen += counts[i];
+            if(seen >= target) return std::min(getUpperBound(i), max);
+        }
+
+        return max;
+    }
+
+    void print(const char* mName) const
+    {
+        std::printf("%-6s %8llu samples", mName, (unsigned long long)total);
+
+        for(auto p : {50.0, 90.0, 99.0, 99.9})
+            std::printf("  p%g %9.1fus", p, getPercentile(p) / 1e3);
+
+        std::printf("  max %9.1fus\n", max / 1e3);
+    }
+};
+
+class FrameProfiler
+{
+public:
+    struct PhaseStats
+    {
+        std::chrono::steady_clock::duration duration{};
+        std::size_t allocations{0}, allocatedBytes{0};
+        PerfCounters::Values events{};
+    };
+
+    using Frame = std::array<PhaseStats, phaseCount>;
+
+private:
+    static constexpr std::size_t noPhase{phaseCount};
+
+    // The phase in progress, and what was measured when it began.
+    std::size_t phase{noPhase};
+    std::chrono::steady_clock::time_point boundaryTime;
+    AllocationCounters boundaryAllocations;
+
+#ifdef ARKANOID_PERF_COUNTERS
+    PerfCounters::Values boundaryEvents{};
+#endif
+
+    // Ends the phase in progress, if any. Every boundary between two
+    // phases reads the clock and the counters only once.
+    std::chrono::steady_clock::time_point markBoundary() noexcept
+    {
+        auto now(std::chrono::steady_clock::now());
+        auto allocations(allocationCounters);
+
+#ifdef ARKANOID_PERF_COUNTERS
+        auto events(counters.read());
+#endif
+
+        if(phase != noPhase)
+        {
+            auto& stats(current[phase]);
+            stats.duration += now - boundaryTime;
+            stats.allocations +=
+                allocations.allocations - boundaryAllocations.allocations;
+            stats.allocatedBytes += allocations.allocatedBytes -
+                                    boundaryAllocations.allocatedBytes;
+
+#ifdef ARKANOID_PERF_COUNTERS
+            for(std::size_t i{0}; i < counters.getCount(); ++i)
+                stats.events[i] += events[i] - boundaryEvents[i];
+#endif
+        }
+
+#ifdef ARKANOID_PERF_COUNTERS
+        boundaryEvents = events;
+#endif
+        boundaryAllocations = allocations;
+        boundaryTime = now;
+        return now;
+    }
+
+public:
+#ifdef ARKANOID_PERF_COUNTERS
+    // The counters are enabled once, and read at every phase boundary.
+    PerfCounters counters{perfEvents::cycles, perfEvents::instructions,
+        perfEvents::l1dMisses, perfEvents::llcMisses,
+        perfEvents::branchMisses};
+
+    FrameProfiler() { counters.start(); }
+#endif
+
+    Frame current, totals;
+    std::size_t frames{0}, framesWithAllocations{0};
+
+    // Durations of whole frames and of simulation ticks, recorded
+    // continuously to expose hitches that averages would hide. Frames
+    // should end before any wait for the framerate limit.
+    DurationHistogram frameTimes, tickTimes;
+    std::chrono::steady_clock::time_point frameStart;
+    std::chrono::steady_clock::duration lastFrameDuration{};
+
+    // Phases are chained: entering a phase ends the previous one, and
+    // `leave` ends the last one. Both return the time of the boundary.
+    std::chrono::steady_clock::time_point enter(Phase mPhase) noexcept
+    {
+        auto now(markBoundary());
+        phase = std::size_t(mPhase);
+
+#ifdef ARKANOID_SAMPLING_PROFILER
+        SamplingProfiler::setPhase(int(mPhase) + 1);
+#endif
+
+        return now;
+    }
+
+    std::chrono::steady_clock::time_point leave() noexcept
+    {
+        auto now(markBoundary());
+        phase = noPhase;
+
+#ifdef ARKANOID_SAMPLING_PROFILER
+        SamplingProfiler::setPhase(0);
+#endif
+
+        return now;
+    }
+
+    void beginFrame() noexcept
+    {
+        current = {};
+        frameStart = std::chrono::steady_clock::now();
+    }
+
+    // Ends the phase in progress too.
+    void endFrame() noexcept
+    {
+        lastFrameDuration = leave() - frameStart;
+        frameTimes.record(lastFrameDuration);
+
+        bool allocated{false};
+        for(std::size_t i{0}; i < phaseCount; ++i)
+        {
+            totals[i].duration += current[i].duration;
+            totals[i].allocations += current[i].allocations;
+            totals[i].allocatedBytes += current[i].allocatedBytes;
+            allocated |= current[i].allocations > 0;
+
+            for(std::size_t e{0}; e < PerfCounters::maxEvents; ++e)
+                totals[i].events[e] += current[i].events[e];
+        }
+
+        ++frames;
+        if(allocated) ++framesWithAllocations;
+    }
+
+    void reset() noexcept
+    {
+        current = totals = {};
+        frames = framesWithAllocations = 0;
+        frameTimes = tickTimes = {};
+    }
+
+    void printDurations() const
+    {
+        frameTimes.print("frame");
+        tickTimes.print("tick");
+    }
+
+    void printSummary() const
+    {
+        std::printf("%zu frames, %zu with allocations\n", frames,
+            framesWithAllocations);
+
+        for(std::size_t i{0}; i < phaseCount; ++i)
+            std::printf("  %-10s %8zu allocations %10zu bytes\n",
+                phaseNames[i], totals[i].allocations,
+                totals[i].allocatedBytes);
+
+#ifdef ARKANOID_PERF_COUNTERS
+        printCounters();
+#endif
+    }
+
+#ifdef ARKANOID_PERF_COUNTERS
+    // Prints the instructions per cycle, and the misses per thousand
+    // instructions, of every phase.
+    void printCounters() const
+    {
+        auto cycles(counters.find("cycles"));
+        auto instructions(counters.find("instructions"));
+
+        if(cycles == -1 || instructions == -1)
+        {
+            std::printf("hardware counters unavailable\n");
+            return;
+        }
+
+        for(std::size_t i{0}; i < phaseCount; ++i)
+        {
+            const auto& events(totals[i].events);
+            double kInstructions(
+                std::max<double>(events[instructions], 1) / 1000.0);
+            double ipc(double(events[instructions]) /
+                       std::max<double>(events[cycles], 1));
+
+            std::printf("  %-10s %6.2f IPC", phaseNames[i], ipc);
+
+            for(std::size_t e{0}; e < counters.getCount(); ++e)
+                if(int(e) != cycles && int(e) != instructions)
+                    std::printf(" %8.3f %s/ki", events[e] / kInstructions,
+                        counters.getName(e));
+
+            std::printf("\n");
+        }
+    }
+#endif
+};
+
+// Timed sequences, such as "respawn the ball after a second" or "flash
+// the victory text", are scheduled on a tick-based sequencer instead of
+// being polled every frame. A sequence is a callable returning the
+// number of ticks until its next step, or `Sequencer::done`. Waiting
+// sequences are stored in a timer wheel, so that they cost nothing
+// until they are due, and their callables live in a fixed pool of
+// slots, so that scheduling never allocates.
+class Sequencer
+{
+public:
+    static constexpr int done{-1};
+
+private:
+    static constexpr std::size_t capacity{32}, storageSize{48};
+    static constexpr std::size_t wheelSize{64};
+    static constexpr int none{-1};
+
+    struct Slot
+    {
+        std::aligned_storage_t<storageSize, alignof(std::max_align_t)>
+            storage;
+        int (*step)(void*);
+        void (*destroy)(void*);
+        int rounds, next;
+    };
+
+    std::array<Slot, capacity> slots;
+    std::array<int, wheelSize> wheel;
+    int freeSlots{0};
+    std::size_t cursor{0};
+
+    void insert(int mIndex, int mDelay) noexcept
+    {
+        auto& slot(slots[mIndex]);
+        auto& bucket(wheel[(cursor + mDelay) % wheelSize]);
+
+        slot.rounds = (mDelay - 1) / wheelSize;
+        slot.next = bucket;
+        bucket = mIndex;
+    }
+
+public:
+    Sequencer() noexcept
+    {
+        wheel.fill(none);
+        for(std::size_t i{0}; i < capacity; ++i) slots[i].next = i + 1;
+        slots[capacity - 1].next = none;
+    }
+
+    Sequencer(const Sequencer&) = delete;
+    Sequencer& operator=(const Sequencer&) = delete;
+
+    ~Sequencer() { clear(); }
+
+    // Schedules the first step of `mSequence` in `mDelay` ticks.
+    // Returns `false` if all slots are in use.
+    template <typename TSequence>
+    bool schedule(int mDelay, TSequence mSequence) noexcept
+    {
+        static_assert(sizeof(TSequence) <= storageSize &&
+                          alignof(TSequence) <= alignof(std::max_align_t),
+            "`TSequence` does not fit in a sequencer slot");
+
+        if(freeSlots == none) return false;
+
+        auto index(freeSlots);
+        auto& slot(slots[index]);
+        freeSlots = slot.next;
+
+        new(&slot.storage) TSequence(std::move(mSequence));
+        slot.step = [](void* mPtr)
+        {
+            return (*static_cast<TSequence*>(mPtr))();
+        };
+        slot.destroy = [](void* mPtr)
+        {
+            static_cast<TSequence*>(mPtr)->~TSequence();
+        };
+
+        insert(index, std::max(mDelay, 1));
+        return true;
+    }
+
+    // Advances by one tick, running the steps that are due.
+    void tick()
+    {
+        cursor = (cursor + 1) % wheelSize;
+
+        auto index(wheel[cursor]);
+        wheel[cursor] = none;
+
+        while(index != none)
+        {
+            auto& slot(slots[index]);
+            auto next(slot.next);
+
+            if(slot.rounds > 0)
+            {
+                --slot.rounds;
+                slot.next = wheel[cursor];
+                wheel[cursor] = index;
+            }
+            else
+            {
+                auto delay(slot.step(&slot.storage));
+
+                if(delay == done)
+                {
+                    slot.destroy(&slot.storage);
+                    slot.next = freeSlots;
+                    freeSlots = index;
+                }
+                else
+                    insert(index, std::max(delay, 1));
+            }
+
+            index = next;
+        }
+    }
+
+    // Cancels all the scheduled sequences.
+    void clear() noexcept
+    {
+        for(auto& bucket : wheel)
+        {
+            for(auto index(bucket); index != none;)
+            {
+                auto& slot(slots[index]);
+                auto next(slot.next);
+
+                slot.destroy(&slot.storage);
+                slot.next = freeSlots;
+                freeSlots = index;
+
+                index = next;
+            }
+
+            bucket = none;
+        }
+    }
+};
+
+constexpr int Sequencer::none;
+
+// The game rules and entities are kept separate from the window and
+// the text, so that whole sessions can also be simulated headless.
+class Simulation
+{
+public:
+    enum class State
+    {
+        Paused,
+        GameOver,
+        InProgress,
+        Victory
+    };
+
+    static constexpr int respawnDelay{60};
+
+    // The game state and every entity, as plain records. Snapshots are
+    // written as text, one record per line, up to an `end` line:
+    //   snapshot <state> <lives> <input left> <input right>
+    //   ball <x> <y> <velocity x> <velocity y>
+    //   brick <x> <y> <required hits>
+    //   paddle <x> <y>
+    // Bricks keep their record once destroyed, with no required hits,
+    // and are not written.
+    struct Snapshot
+    {
+        struct BallRecord
+        {
+            float x, y, velocityX, velocityY;
+        };
+
+        struct BrickRecord
+        {
+            float x, y;
+            int requiredHits;
+        };
+
+        State state;
+        int remainingLives;
+        InputState input;
+        std::size_t generation{0};
+        std::vector<BallRecord> balls;
+        std::vector<BrickRecord> bricks;
+        std::vector<sf::Vector2f> paddles;
+
+        void write(std::FILE* mFile) const
+        {
+            std::fprintf(mFile, "snapshot %d %d %d %d\n", int(state),
+                remainingLives, int(input.left), int(input.right));
+
+            for(const auto& b : balls)
+                std::fprintf(mFile, "ball %g %g %g %g\n", b.x, b.y,
+                    b.velocityX, b.velocityY);
+            for(const auto& b : bricks)
+                if(b.requiredHits > 0)
+                    std::fprintf(
+                        mFile, "brick %g %g %d\n", b.x, b.y, b.requiredHits);
+            for(const auto& p : paddles)
+                std::fprintf(mFile, "paddle %g %g\n", p.x, p.y);
+
+            std::fprintf(mFile, "end\n");
+        }
+    };
+
+    Manager manager;
+    InputState input;
+    FrameProfiler profiler;
+    Sequencer sequencer;
+    State state{State::GameOver};
+    int remainingLives{0};
+
+    // Live brick counts, indexed by required hits, kept up to date on
+    // creation and on every hit, for the HUD.
+    std::array<int, Brick::maxHits + 1> brickCounts{};
+
+    // The collision events of the last tick. They stay available to
+    // other consumers (sounds, particles) until the next tick.
+    std::vector<CollisionEvent> collisionEvents;
+
+private:
+    struct BrickChange
+    {
+        int snapshotIndex, requiredHits;
+    };
+
+    // Bricks only change when they are hit: the hits of the last tick
+    // are enough to bring a snapshot of the previous one up to date.
+    // Every reset starts a new generation of bricks.
+    std::vector<BrickChange> brickChanges;
+    std::size_t generation{0};
+    int createdBricks{0};
+
+    static int getHitLevel(int mHits) noexcept
+    {
+        return std::min(mHits, Brick::maxHits);
+    }
+
+    // Bricks are at the top of the world, and the player at its bottom:
+    // balls spawn in the bottom screen.
+    void spawnBall()
+    {
+        manager.create<Ball>(worldWidth / 2.f, worldHeight - wndHeight / 2.f);
+    }
+
+    void scheduleRespawn()
+    {
+        sequencer.schedule(respawnDelay, [this]
+            {
+                spawnBall();
+                return Sequencer::done;
+            });
+    }
+
+    // State transitions are driven by the manager's live counts: no
+    // query is needed in the game loop.
+    void onBallsLost()
+    {
+        if(state != State::InProgress) return;
+
+        // Remove a life, and spawn a new ball after a short delay.
+        // If the player has no more remaining lives, it's game over!
+        --remainingLives;
+        if(remainingLives > 0)
+            scheduleRespawn();
+        else
+            state = State::GameOver;
+    }
+
+    void onBricksDestroyed()
+    {
+        if(state == State::InProgress) state = State::Victory;
+    }
+
+    void reset()
+    {
+        sequencer.clear();
+        manager.reset();
+        brickCounts = {};
+        collisionEvents.clear();
+        brickChanges.clear();
+        createdBricks = 0;
+        ++generation;
+    }
+
+    // A brick hit by several balls in the same tick may already have
+    // been destroyed by the first one.
+    void damageBrick(Brick& mBrick) noexcept
+    {
+        if(mBrick.destroyed) return;
+
+        // Instead of immediately destroying the brick upon collision,
+        // we decrease and check its required hits first.
+        --brickCounts[getHitLevel(mBrick.requiredHits)];
+        --mBrick.requiredHits;
+
+        if(mBrick.requiredHits <= 0)
+            mBrick.destroyed = true;
+        else
+            ++brickCounts[getHitLevel(mBrick.requiredHits)];
+
+        brickChanges.push_back({mBrick.snapshotIndex, mBrick.requiredHits});
+    }
+
+    void processCollisionEvents() noexcept
+    {
+        for(const auto& event : collisionEvents)
+            if(event.type == CollisionEvent::Type::BallBrick)
+                damageBrick(static_cast<Brick&>(*event.second));
+    }
+
+public:
+    Simulation()
+    {
+        manager.onEmpty<Ball>([this]
+            {
+                onBallsLost();
+            });
+        manager.onEmpty<Brick>([this]
+            {
+                onBricksDestroyed();
+            });
+
+        collisionEvents.reserve(64);
+        brickChanges.reserve(64);
+    }
+
+    // Called by the collision handlers.
+    void emit(const CollisionEvent& mEvent)
+    {
+        collisionEvents.emplace_back(mEvent);
+    }
+
+    Brick& createBrick(float mX, float mY, int mHits)
+    {
+        auto& brick(manager.create<Brick>(mX, mY));
+        brick.requiredHits = mHits;
+        brick.snapshotIndex = createdBricks++;
+        ++brickCounts[getHitLevel(mHits)];
+        return brick;
+    }
+
+    void restart()
+    {
+        remainingLives = 3;
+
+        state = State::Paused;
+        reset();
+
+        manager.reserve<Brick>(BrickLattice::countX * BrickLattice::countY);
+        for(int iX{0}; iX < BrickLattice::countX; ++iX)
+            for(int iY{0}; iY < BrickLattice::countY; ++iY)
+            {
+                auto position(BrickLattice::getPosition(iX, iY));
+                createBrick(position.x, position.y, 1 + ((iX * iY) % 3));
+            }
+
+        spawnBall();
+        manager.create<Paddle>(worldWidth / 2.f, worldHeight - 50.f, input);
+    }
+
+    // Captures the game state and every entity into `mSnapshot`,
+    // reusing its memory. Bricks are only copied when some were
+    // created since the last capture: otherwise, the hits of the last
+    // tick are applied to the snapshot's records, so `mSnapshot` must
+    // be captured before every tick.
+    void capture(Snapshot& mSnapshot)
+    {
+        mSnapshot.state = state;
+        mSnapshot.remainingLives = remainingLives;
+        mSnapshot.input = input;
+        mSnapshot.balls.clear();
+        mSnapshot.paddles.clear();
+
+        manager.forEach<Ball>([&mSnapshot](auto& mBall)
+            {
+                mSnapshot.balls.push_back({mBall.x(), mBall.y(),
+                    mBall.velocity.x, mBall.velocity.y});
+            });
+        manager.forEach<Paddle>([&mSnapshot](auto& mPaddle)
+            {
+                mSnapshot.paddles.push_back(mPaddle.position);
+            });
+
+        if(mSnapshot.generation == generation &&
+            mSnapshot.bricks.size() == std::size_t(createdBricks))
+        {
+            for(const auto& change : brickChanges)
+                mSnapshot.bricks[change.snapshotIndex].requiredHits =
+                    change.requiredHits;
+
+            return;
+        }
+
+        mSnapshot.generation = generation;
+        mSnapshot.bricks.assign(createdBricks, {});
+        manager.forEach<Brick>([&mSnapshot](auto& mBrick)
+            {
+                mSnapshot.bricks[mBrick.snapshotIndex] = {
+                    mBrick.x(), mBrick.y(), mBrick.requiredHits};
+            });
+    }
+
+    // Skips to the next snapshot of `mFile` and restores it. Returns
+    // `false` if there are no more snapshots.
+    bool readSnapshot(std::FILE* mFile)
+    {
+        char record[16];
+        int stateValue, left, right;
+
+        while(std::fscanf(mFile, "%15s", record) == 1)
+        {
+            if(std::strcmp(record, "snapshot") != 0) continue;
+            if(std::fscanf(mFile, "%d %d %d %d", &stateValue,
+                   &remainingLives, &left, &right) != 4)
+                return false;
+
+            state = State(stateValue);
+            input.left = left != 0;
+            input.right = right != 0;
+            reset();
+
+            while(std::fscanf(mFile, "%15s", record) == 1 &&
+                  std::strcmp(record, "end") != 0)
+            {
+                float x, y, vx, vy;
+                int hits;
+
+                if(std::strcmp(record, "ball") == 0 &&
+                    std::fscanf(mFile, "%f %f %f %f", &x, &y, &vx, &vy) == 4)
+                    manager.create<Ball>(x, y).velocity = {vx, vy};
+                else if(std::strcmp(record, "brick") == 0 &&
+                        std::fscanf(mFile, "%f %f %d", &x, &y, &hits) == 3)
+                    createBrick(x, y, hits);
+                else if(std::strcmp(record, "paddle") == 0 &&
+                        std::fscanf(mFile, "%f %f", &x, &y) == 2)
+                    manager.create<Paddle>(x, y, input);
+            }
+
+            // The snapshot may have been taken while a ball was
+            // about to respawn.
+            if(manager.empty<Ball>() && remainingLives > 0)
+                scheduleRespawn();
+
+            return true;
+        }
+
+        return false;
+    }
+
+    void togglePause() noexcept
+    {
+        if(state == State::Paused)
+            state = State::InProgress;
+        else if(state == State::InProgress)
+            state = State::Paused;
+    }
+
+    // Advances the game by one tick. Must only be called while the
+    // game is in progress.
+    void update()
+    {
+        auto tickStart(profiler.enter(Phase::Rules));
+        sequencer.tick();
+
+        profiler.enter(Phase::Update);
+        manager.update(StaticEntities{});
+
+        profiler.enter(Phase::Collision);
+        collisionEvents.clear();
+        solveCollisions(manager, *this, Collidables{});
+
+        profiler.enter(Phase::Events);
+        brickChanges.clear();
+        processCollisionEvents();
+
+        profiler.enter(Phase::Refresh);
+        manager.refresh();
+
+        profiler.tickTimes.record(profiler.leave() - tickStart);
+    }
+};
+
+// When a frame's work exceeds its budget, the watchdog appends a
+// record of it to a bounded on-disk log: the frame's phase timings and
+// allocations, the entity counts of every group, and a snapshot of the
+// simulation taken before the frame's tick. Snapshots can be replayed
+// headless (see `ARKANOID_REPLAY` at the end of the file), starting
+// right before the hitch.
+class FrameWatchdog
+{
+private:
+    std::chrono::steady_clock::duration budget;
+    const char* path;
+    std::size_t maxHitches, hitches{0}, frame{0};
+
+    // Brought up to date every frame, in memory: only written out for
+    // hitches.
+    Simulation::Snapshot snapshot;
+
+public:
+    FrameWatchdog(std::chrono::steady_clock::duration mBudget,
+        const char* mPath, std::size_t mMaxHitches) noexcept
+        : budget{mBudget}, path{mPath}, maxHitches{mMaxHitches}
+    {
+    }
+
+    // Must be called before every frame's tick.
+    void capture(Simulation& mSimulation) { mSimulation.capture(snapshot); }
+
+    // Must be called after `FrameProfiler::endFrame`.
+    void check(Simulation& mSimulation)
+    {
+        ++frame;
+
+        const auto& profiler(mSimulation.profiler);
+        if(profiler.lastFrameDuration <= budget || hitches == maxHitches)
+            return;
+
+        // The log is truncated by the first hitch of every run.
+        auto file(std::fopen(path, hitches == 0 ? "w" : "a"));
+        if(file == nullptr) return;
+        ++hitches;
+
+        using Us = std::chrono::duration<double, std::micro>;
+        std::fprintf(file, "hitch %zu %.1fus (budget %.1fus)\n", frame,
+            Us(profiler.lastFrameDuration).count(), Us(budget).count());
+
+        for(std::size_t i{0}; i < phaseCount; ++i)
+        {
+            const auto& phase(profiler.current[i]);
+            std::fprintf(file, "phase %s %.1fus %zu allocations %zu bytes\n",
+                phaseNames[i], Us(phase.duration).count(), phase.allocations,
+                phase.allocatedBytes);
+        }
+
+        auto& manager(mSimulation.manager);
+        std::fprintf(file, "groups balls %zu bricks %zu paddles %zu\n",
+            manager.count<Ball>(), manager.count<Brick>(),
+            manager.count<Paddle>());
+
+        snapshot.write(file);
+        std::fclose(file);
+    }
+};
+
+// The camera shows a window-sized part of the world. It scrolls
+// towards the lowest ball, the one the player has to catch, and never
+// shows anything outside of the world.
+class Camera
+{
+private:
+    static constexpr float smoothing{0.1f};
+
+    sf::View view{sf::FloatRect(0, 0, wndWidth, wndHeight)};
+
+public:
+    void follow(float mY)
+    {
+        auto halfHeight(wndHeight / 2.f);
+        auto targetY(
+            std::max(halfHeight, std::min(worldHeight - halfHeight, mY)));
+
+        const auto& center(view.getCenter());
+        view.setCenter(
+            worldWidth / 2.f, center.y + (targetY - center.y) * smoothing);
+    }
+
+    const sf::View& getView() const noexcept { return view; }
+
+    Bounds getBounds() const noexcept
+    {
+        const auto& center(view.getCenter());
+        const auto& size(view.getSize());
+        return {center.x - size.x / 2.f, center.y - size.y / 2.f,
+            center.x + size.x / 2.f, center.y + size.y / 2.f};
+    }
+};
+
+class Game
+{
+private:
+    using State = Simulation::State;
+
+    sf::RenderWindow window{{wndWidth, wndHeight}, "Arkanoid - 12"};
+    Simulation simulation;
+    Camera camera;
+
+    sf::Font liberationSans;
+    sf::Text textState, textLives;
+
+    bool pausePressedLastFrame{false};
+
+    FrameWatchdog watchdog{
+        std::chrono::microseconds{16667}, "arkanoid.hitches", 32};
+
+#ifdef ARKANOID_SAMPLING_PROFILER
+    // Sampling starts with the game, and `F9` toggles it.
+    SamplingProfiler samplingProfiler{"arkanoid.folded"};
+    bool profilerPressedLastFrame{false};
+#endif
+
+    // `F10` dumps the manager's memory statistics.
+    bool statsPressedLastFrame{false};
+
+    void writeStats()
+    {
+        auto file(std::fopen("arkanoid.stats.json", "w"));
+        if(file == nullptr) return;
+
+        simulation.manager.getStats().write(file);
+        std::fclose(file);
+    }
+
+    // Text strings are only updated when their content changes, as
+    // `setString` allocates.
+    State displayedState{State::InProgress};
+    int displayedLives{-1};
+    std::array<int, Brick::maxHits + 1> displayedBrickCounts{};
+
+    // The game's own sequencer is advanced every frame, even when the
+    // simulation is not in progress.
+    static constexpr int flashTicks{20};
+    Sequencer sequencer;
+    bool textStateVisible{true};
+
+public:
+    Game()
+    {
+        window.setFramerateLimit(60);
+
+        liberationSans.loadFromFile(
+            R"(/usr/share/fonts/TTF/LiberationSans-Regular.ttf)");
+
+        textState.setFont(liberationSans);
+        textState.setPosition(10, 10);
+        textState.setCharacterSize(35.f);
+        textState.setColor(sf::Color::White);
+
+        textLives.setFont(liberationSans);
+        textLives.setPosition(10, 10);
+        textLives.setCharacterSize(15.f);
+        textLives.setColor(sf::Color::White);
+
+#ifdef ARKANOID_SAMPLING_PROFILER
+        samplingProfiler.start();
+#endif
+    }
+
+    void restart() { simulation.restart(); }
+
+    void flashVictoryText()
+    {
+        sequencer.schedule(flashTicks, [this]
+            {
+                if(simulation.state != State::Victory)
+                {
+                    textStateVisible = true;
+                    return Sequencer::done;
+                }
+
+                textStateVisible = !textStateVisible;
+                return flashTicks;
+            });
+    }
+
+    void run()
+    {
+        auto& state(simulation.state);
+        auto& profiler(simulation.profiler);
+
+        while(true)
+        {
+            profiler.beginFrame();
+            sequencer.tick();
+            window.clear(sf::Color::Black);
+
+            if(sf::Keyboard::isKeyPressed(sf::Keyboard::Key::Escape)) break;
+
+            simulation.input.left =
+                sf::Keyboard::isKeyPressed(sf::Keyboard::Key::Left);
+            simulation.input.right =
+                sf::Keyboard::isKeyPressed(sf::Keyboard::Key::Right);
+
+            if(sf::Keyboard::isKeyPressed(sf::Keyboard::Key::P))
+            {
+                if(!pausePressedLastFrame) simulation.togglePause();
+                pausePressedLastFrame = true;
+            }
+            else
+                pausePressedLastFrame = false;
+
+            if(sf::Keyboard::isKeyPressed(sf::Keyboard::Key::R)) restart();
+
+#ifdef ARKANOID_SAMPLING_PROFILER
+            if(sf::Keyboard::isKeyPressed(sf::Keyboard::Key::F9))
+            {
+                if(!profilerPressedLastFrame) samplingProfiler.toggle();
+                profilerPressedLastFrame = true;
+            }
+            else
+                profilerPressedLastFrame = false;
+#endif
+
+            if(sf::Keyboard::isKeyPressed(sf::Keyboard::Key::F10))
+            {
+                if(!statsPressedLastFrame) writeStats();
+                statsPressedLastFrame = true;
+            }
+            else
+                statsPressedLastFrame = false;
+
+            // The state this frame starts from, and its input.
+            watchdog.capture(simulation);
+
+            // If the game is not in progress, do not draw or update
+            // game elements and display information to the player.
+            if(state != State::InProgress)
+            {
+                profiler.enter(Phase::Draw);
+
+                if(state != displayedState)
+                {
+                    if(state == State::Paused)
+                        textState.setString("Paused");
+                    else if(state == State::GameOver)
+                        textState.setString("Game over!");
+                    else if(state == State::Victory)
+                    {
+                        textState.setString("You won!");
+                        flashVictoryText();
+                    }
+
+                    displayedState = state;
+                }
+
+                if(textStateVisible) window.draw(textState);
+            }
+            else
+            {
+                simulation.update();
+
+                profiler.enter(Phase::Draw);
+
+                // Only the entities seen by the camera are drawn. The
+                // HUD is drawn over them, in window coordinates.
+                auto lowestBallY(-1.f);
+                simulation.manager.forEach<Ball>([&lowestBallY](auto& mBall)
+                    {
+                        lowestBallY = std::max(lowestBallY, mBall.y());
+                    });
+                if(lowestBallY >= 0.f) camera.follow(lowestBallY);
+
+                window.setView(camera.getView());
+                simulation.manager.draw(
+                    window, StaticEntities{}, camera.getBounds());
+                window.setView(window.getDefaultView());
+
+                // Update the HUD string (lives and bricks left by
+                // required hits) and draw it.
+                if(simulation.remainingLives != displayedLives ||
+                    simulation.brickCounts != displayedBrickCounts)
+                {
+                    displayedLives = simulation.remainingLives;
+                    displayedBrickCounts = simulation.brickCounts;
+
+                    char hud[64];
+                    std::snprintf(hud, sizeof(hud),
+                        "Lives: %d   Bricks: %d / %d / %d", displayedLives,
+                        displayedBrickCounts[1], displayedBrickCounts[2],
+                        displayedBrickCounts[3]);
+                    textLives.setString(hud);
+                }
+
+                window.draw(textLives);
+            }
+
+            // Frames end before `display`, which waits for the
+            // framerate limit: only the frame's work is measured.
+            profiler.endFrame();
+            watchdog.check(simulation);
+            window.display();
+        }
+
+        profiler.printDurations();
+
+#if defined(ARKANOID_TRACK_ALLOCATIONS) || defined(ARKANOID_PERF_COUNTERS)
+        profiler.printSummary();
+#endif
+
+#ifdef ARKANOID_SAMPLING_PROFILER
+        samplingProfiler.stop();
+        samplingProfiler.write(phaseNames);
+#endif
+    }
+};
+
+// Allocation-free frames are a hard requirement. Compiling with
+// `ARKANOID_ALLOCATION_CHECK` replaces the game with a headless check:
+// an autopilot plays the game, and the program fails if any allocation
+// happens during the steady-state ticks that follow a short warm-up.
+// The autopilot of headless sessions moves the paddle under the ball,
+// or away from it when `mMissBall` is set.
+void steerPaddle(Simulation& mSimulation, bool mMissBall)
+{
+    float ballX{0.f}, paddleX{0.f};
+    mSimulation.manager.forEach<Ball>([&ballX](auto& mBall)
+        {
+            ballX = mBall.x();
+        });
+    mSimulation.manager.forEach<Paddle>([&paddleX](auto& mPaddle)
+        {
+            paddleX = mPaddle.x();
+        });
+
+    // To miss, the paddle goes to the other half of the world.
+    if(mMissBall) ballX = ballX < worldWidth / 2.f ? worldWidth : 0.f;
+
+    mSimulation.input.left = ballX < paddleX;
+    mSimulation.input.right = ballX > paddleX;
+}
+
+#if defined(ARKANOID_ALLOCATION_CHECK)
+int main()
+{
+    constexpr int warmUpTicks{60}, checkedTicks{1800};
+
+    Simulation simulation;
+    simulation.restart();
+    simulation.togglePause();
+
+    auto& manager(simulation.manager);
+    auto& profiler(simulation.profiler);
+    auto startLives(simulation.remainingLives);
+
+    // The autopilot keeps the paddle under the ball, except at the
+    // start of the checked ticks: it lets the first ball fall, so
+    // that losing a life and respawning a ball are checked too.
+    bool missBall{false};
+
+    for(int i{0}; i < warmUpTicks + checkedTicks; ++i)
+    {
+        if(i == warmUpTicks)
+        {
+            profiler.reset();
+            missBall = true;
+        }
+
+        if(simulation.state != Simulation::State::InProgress) break;
+        if(simulation.remainingLives < startLives) missBall = false;
+
+        steerPaddle(simulation, missBall);
+
+        profiler.beginFrame();
+        simulation.update();
+        profiler.endFrame();
+    }
+
+    profiler.printDurations();
+    profiler.printSummary();
+
+    if(simulation.remainingLives == startLives || manager.empty<Ball>())
+    {
+        std::printf("no ball was lost and respawned\n");
+        return EXIT_FAILURE;
+    }
+
+    return profiler.framesWithAllocations == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// Compiling with `ARKANOID_REPLAY` replaces the game with a headless
+// replay of the hitches logged by the watchdog: every snapshot is
+// restored and simulated for a second, with its timings printed.
+#elif defined(ARKANOID_REPLAY)
+int main()
+{
+    constexpr int replayedTicks{60};
+
+    auto file(std::fopen("arkanoid.hitches", "r"));
+    if(file == nullptr) return EXIT_FAILURE;
+
+    Simulation simulation;
+    for(int i{1}; simulation.readSnapshot(file); ++i)
+    {
+        simulation.profiler.reset();
+        simulation.state = Simulation::State::InProgress;
+
+        for(int t{0}; t < replayedTicks; ++t)
+        {
+            if(simulation.state != Simulation::State::InProgress) break;
+
+            simulation.profiler.beginFrame();
+            simulation.update();
+            simulation.profiler.endFrame();
+        }
+
+        std::printf("hitch %d\n", i);
+        simulation.profiler.printDurations();
+    }
+
+    std::fclose(file);
+    return EXIT_SUCCESS;
+}
+
+// Compiling with `ARKANOID_SOAK` replaces the game with a headless soak
+// run: the autopilot plays for the number of ticks given as the first
+// argument (an hour of play by default), and the game restarts every
+// time it ends. With `ARKANOID_SAMPLING_PROFILER`, the whole run is
+// sampled, and `SIGUSR1` toggles sampling.
+#elif defined(ARKANOID_SOAK)
+
+#ifdef ARKANOID_SAMPLING_PROFILER
+volatile std::sig_atomic_t samplingToggles{0};
+#endif
+
+int main(int argc, char** argv)
+{
+    long long ticks{60 * 60 * 60};
+    if(argc > 1) ticks = std::strtoll(argv[1], nullptr, 10);
+
+#ifdef ARKANOID_SAMPLING_PROFILER
+    SamplingProfiler samplingProfiler{"arkanoid.folded"};
+    samplingProfiler.start();
+
+#ifdef SIGUSR1
+    std::signal(SIGUSR1, [](int)
+        {
+            ++samplingToggles;
+        });
+#endif
+    std::sig_atomic_t handledToggles{0};
+#endif
+
+    Simulation simulation;
+    auto& profiler(simulation.profiler);
+
+    for(long long i{0}; i < ticks; ++i)
+    {
+#ifdef ARKANOID_SAMPLING_PROFILER
+        for(; handledToggles != samplingToggles; ++handledToggles)
+            samplingProfiler.toggle();
+#endif
+
+        if(simulation.state != Simulation::State::InProgress)
+        {
+            simulation.restart();
+            simulation.togglePause();
+        }
+
+        steerPaddle(simulation, false);
+
+        profiler.beginFrame();
+        simulation.update();
+        profiler.endFrame();
+    }
+
+#ifdef ARKANOID_SAMPLING_PROFILER
+    samplingProfiler.stop();
+    samplingProfiler.write(phaseNames);
+#endif
+
+    profiler.printDurations();
+
+#if defined(ARKANOID_TRACK_ALLOCATIONS) || defined(ARKANOID_PERF_COUNTERS)
+    profiler.printSummary();
+#endif
+
+    return EXIT_SUCCESS;
+}
+
+// Benchmark programs include this file to reuse our entities and
+// manager: they define `ARKANOID_NO_MAIN` and provide their own `main`.
+#elif !defined(ARKANOID_NO_MAIN)
+int main()
+{
+    Game game;
+    game.restart();
+    game.run();
+    return 0;
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,178 @@
+// Copyright (c) 2014 Vittorio Romeo
+// License: MIT License | http://opensource.org/licenses/MIT
+// http://vittorioromeo.info | vittorio.romeo@outlook.com
+
+// Hardware event counters (cycles, instructions, cache and branch
+// misses), read through Linux's `perf_event_open`. All the events of a
+// `PerfCounters` instance are opened as a single group, so that they
+// are scheduled together and read with a single system call.
+//
+// Events that cannot be opened (unsupported platform or CPU,
+// containers, restrictive `perf_event_paranoid`) are skipped: when
+// none can be opened, the counters simply report nothing.
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+class PerfCounters
+{
+public:
+    static constexpr std::size_t maxEvents{8};
+
+    struct Event
+    {
+        const char* name;
+        std::uint32_t type;
+        std::uint64_t config;
+    };
+
+    using Values = std::array<std::uint64_t, maxEvents>;
+
+private:
+    int leader{-1};
+    std::array<int, maxEvents> fds;
+    std::array<const char*, maxEvents> names;
+    std::size_t count{0};
+
+public:
+    PerfCounters(std::initializer_list<Event> mEvents)
+    {
+#ifdef __linux__
+        for(const auto& e : mEvents)
+        {
+            if(count == maxEvents) break;
+
+            perf_event_attr attr;
+            std::memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = e.type;
+            attr.config = e.config;
+            attr.disabled = leader == -1;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_GROUP |
+                               PERF_FORMAT_TOTAL_TIME_ENABLED |
+                               PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+            int fd(syscall(SYS_perf_event_open, &attr, 0, -1, leader, 0));
+            if(fd == -1) continue;
+
+            if(leader == -1) leader = fd;
+            fds[count] = fd;
+            names[count] = e.name;
+            ++count;
+        }
+#else
+        (void)mEvents;
+#endif
+    }
+
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    ~PerfCounters()
+    {
+#ifdef __linux__
+        for(std::size_t i{0}; i < count; ++i) close(fds[i]);
+#endif
+    }
+
+    bool isAvailable() const noexcept { return count > 0; }
+    std::size_t getCount() const noexcept { return count; }
+    const char* getName(std::size_t mIndex) const noexcept
+    {
+        return names[mIndex];
+    }
+
+    // Returns the index of the event called `mName`, or `-1` if it
+    // could not be opened.
+    int find(const char* mName) const noexcept
+    {
+        for(std::size_t i{0}; i < count; ++i)
+            if(std::strcmp(names[i], mName) == 0) return i;
+
+        return -1;
+    }
+
+    void start() noexcept
+    {
+#ifdef __linux__
+        if(!isAvailable()) return;
+        ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+#endif
+    }
+
+    void stop() noexcept
+    {
+#ifdef __linux__
+        if(!isAvailable()) return;
+        ioctl(leader, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+#endif
+    }
+
+    // Returns the counts since the last `start`, in event order. If the
+    // kernel had to multiplex the group, the counts are scaled up.
+    Values read() const noexcept
+    {
+        Values result{};
+
+#ifdef __linux__
+        if(!isAvailable()) return result;
+
+        // Layout: event count, time enabled, time running, values.
+        std::uint64_t buffer[3 + maxEvents];
+        if(::read(leader, buffer, sizeof(buffer)) <= 0) return result;
+
+        auto enabled(buffer[1]), running(buffer[2]);
+        if(running == 0) return result;
+
+        for(std::size_t i{0}; i < count && i < buffer[0]; ++i)
+            result[i] = buffer[3 + i] * (double(enabled) / running);
+#endif
+
+        return result;
+    }
+};
+
+namespace perfEvents
+{
+#ifdef __linux__
+    constexpr std::uint64_t cacheReadMiss(std::uint64_t mCache) noexcept
+    {
+        return mCache | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+               (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    }
+
+    constexpr PerfCounters::Event cycles{
+        "cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES};
+    constexpr PerfCounters::Event instructions{
+        "instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS};
+    constexpr PerfCounters::Event branchMisses{
+        "branch_misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES};
+    constexpr PerfCounters::Event cacheMisses{
+        "cache_misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES};
+    constexpr PerfCounters::Event l1dMisses{"l1d_misses",
+        PERF_TYPE_HW_CACHE, cacheReadMiss(PERF_COUNT_HW_CACHE_L1D)};
+    constexpr PerfCounters::Event llcMisses{"llc_misses",
+        PERF_TYPE_HW_CACHE, cacheReadMiss(PERF_COUNT_HW_CACHE_LL)};
+#else
+    constexpr PerfCounters::Event cycles{"cycles", 0, 0};
+    constexpr PerfCounters::Event instructions{"instructions", 0, 0};
+    constexpr PerfCounters::Event branchMisses{"branch_misses", 0, 0};
+    constexpr PerfCounters::Event cacheMisses{"cache_misses", 0, 0};
+    constexpr PerfCounters::Event l1dMisses{"l1d_misses", 0, 0};
+    constexpr PerfCounters::Event llcMisses{"llc_misses", 0, 0};
+#endif
+}
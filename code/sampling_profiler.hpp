@@ -0,0 +1,256 @@
+// Copyright (c) 2014 Vittorio Romeo
+// License: MIT License | http://opensource.org/licenses/MIT
+// http://vittorioromeo.info | vittorio.romeo@outlook.com
+
+// In-process sampling profiler for long headless soak runs (Linux).
+// A `SIGPROF` timer interrupts the process at a fixed rate of CPU time,
+// and the signal handler records the current call stack together with
+// the current frame phase. Samples are aggregated directly in the
+// handler into a fixed-size open-addressing table: there are no locks
+// and no allocations while sampling. Once sampling is stopped, `write`
+// outputs the table as folded stacks (`phase;outer;...;inner count`),
+// ready to be turned into a flame graph.
+//
+// Function names are resolved with `dladdr`: link with `-rdynamic` to
+// get the names of the functions of the executable itself. Frames
+// that cannot be resolved are printed as addresses.
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <string>
+
+#ifdef __linux__
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <sys/time.h>
+#endif
+
+class SamplingProfiler
+{
+public:
+    static constexpr std::size_t maxDepth{32}, tableSize{4096};
+
+private:
+    struct Entry
+    {
+        std::uint64_t hash;
+        std::uint32_t count;
+        int phase;
+        int depth;
+        std::array<void*, maxDepth> frames;
+    };
+
+    // There can only be one `SIGPROF` handler per process.
+    static SamplingProfiler* instance;
+    static volatile std::sig_atomic_t currentPhase;
+
+    std::string outputPath;
+    std::unique_ptr<Entry[]> table{new Entry[tableSize]()};
+    std::atomic<std::uint64_t> samples{0}, dropped{0};
+    bool running{false};
+
+#ifdef __linux__
+    static void onSignal(int)
+    {
+        if(instance != nullptr) instance->record();
+    }
+
+    void record() noexcept
+    {
+        std::array<void*, maxDepth + 2> buffer;
+        int depth(backtrace(buffer.data(), buffer.size()));
+
+        // Skip the handler and the signal trampoline.
+        constexpr int skipped{2};
+        depth = std::max(0, depth - skipped);
+        auto frames(buffer.data() + skipped);
+        int phase(currentPhase);
+
+        // FNV-1a over the phase and the return addresses.
+        std::uint64_t hash{14695981039346656037ull ^ std::uint64_t(phase)};
+        for(int i{0}; i < depth; ++i)
+            hash = (hash ^ reinterpret_cast<std::uintptr_t>(frames[i])) *
+                   1099511628211ull;
+        hash |= 1; // Zero marks empty entries.
+
+        ++samples;
+
+        for(std::size_t probe{0}; probe < tableSize; ++probe)
+        {
+            auto& e(table[(hash + probe) % tableSize]);
+
+            if(e.hash == hash)
+            {
+                ++e.count;
+                return;
+            }
+
+            if(e.hash == 0)
+            {
+                e.phase = phase;
+                e.depth = depth;
+                std::copy(frames, frames + depth, e.frames.data());
+                e.count = 1;
+                e.hash = hash;
+                return;
+            }
+        }
+
+        ++dropped;
+    }
+
+    static std::string symbolize(void* mAddress)
+    {
+        Dl_info info;
+        if(dladdr(mAddress, &info) == 0 || info.dli_sname == nullptr)
+        {
+            char buffer[32];
+            std::snprintf(buffer, sizeof(buffer), "%p", mAddress);
+            return buffer;
+        }
+
+        int status{0};
+        auto demangled(
+            abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status));
+
+        std::string result{status == 0 ? demangled : info.dli_sname};
+        std::free(demangled);
+
+        // Semicolons separate frames in the folded format.
+        for(auto& c : result)
+            if(c == ';') c = ',';
+
+        return result;
+    }
+#endif
+
+public:
+    SamplingProfiler(std::string mOutputPath)
+        : outputPath{std::move(mOutputPath)}
+    {
+#ifdef __linux__
+        instance = this;
+
+        // `backtrace` loads its unwinder lazily: make sure that this
+        // happens now, outside of the signal handler.
+        void* warmUp[1];
+        backtrace(warmUp, 1);
+
+        struct sigaction action;
+        std::memset(&action, 0, sizeof(action));
+        action.sa_handler = &onSignal;
+        action.sa_flags = SA_RESTART;
+        sigemptyset(&action.sa_mask);
+        sigaction(SIGPROF, &action, nullptr);
+#endif
+    }
+
+    SamplingProfiler(const SamplingProfiler&) = delete;
+    SamplingProfiler& operator=(const SamplingProfiler&) = delete;
+
+    ~SamplingProfiler()
+    {
+        stop();
+        instance = nullptr;
+    }
+
+    // Starts sampling `mFrequency` times per second of CPU time.
+    void start(int mFrequency = 1000) noexcept
+    {
+#ifdef __linux__
+        itimerval timer{};
+        timer.it_interval.tv_usec = 1000000 / mFrequency;
+        timer.it_value = timer.it_interval;
+        setitimer(ITIMER_PROF, &timer, nullptr);
+        running = true;
+#else
+        (void)mFrequency;
+#endif
+    }
+
+    void stop() noexcept
+    {
+#ifdef __linux__
+        itimerval timer{};
+        setitimer(ITIMER_PROF, &timer, nullptr);
+        running = false;
+#endif
+    }
+
+    void toggle() noexcept
+    {
+        if(running)
+            stop();
+        else
+            start();
+    }
+
+    bool isRunning() const noexcept { return running; }
+
+    // Sets the phase that following samples are attributed to, and
+    // returns the previous one.
+    static int setPhase(int mPhase) noexcept
+    {
+        int previous(currentPhase);
+        currentPhase = mPhase;
+        return previous;
+    }
+
+    // Writes the folded stacks to the output path. Sampling must be
+    // stopped. `mPhaseNames[i]` is the name of phase `i + 1`: samples
+    // taken outside of any phase are reported as "other".
+    template <std::size_t TPhaseCount>
+    void write(const char* const (&mPhaseNames)[TPhaseCount]) const
+    {
+#ifdef __linux__
+        auto file(std::fopen(outputPath.c_str(), "w"));
+        if(file == nullptr) return;
+
+        std::map<void*, std::string> symbols;
+
+        for(std::size_t i{0}; i < tableSize; ++i)
+        {
+            const auto& e(table[i]);
+            if(e.hash == 0) continue;
+
+            auto phase(e.phase >= 1 && std::size_t(e.phase) <= TPhaseCount
+                           ? mPhaseNames[e.phase - 1]
+                           : "other");
+            std::fprintf(file, "%s", phase);
+
+            for(int f{e.depth - 1}; f >= 0; --f)
+            {
+                auto address(e.frames[f]);
+                auto itr(symbols.find(address));
+                if(itr == std::end(symbols))
+                    itr = symbols.emplace(address, symbolize(address)).first;
+
+                std::fprintf(file, ";%s", itr->second.c_str());
+            }
+
+            std::fprintf(file, " %u\n", e.count);
+        }
+
+        std::fclose(file);
+        std::printf("%llu samples (%llu dropped) written to %s\n",
+            (unsigned long long)samples.load(),
+            (unsigned long long)dropped.load(), outputPath.c_str());
+#else
+        (void)mPhaseNames;
+#endif
+    }
+};
+
+SamplingProfiler* SamplingProfiler::instance{nullptr};
+volatile std::sig_atomic_t SamplingProfiler::currentPhase{0};